@@ -90,10 +90,13 @@ void Controller::init_panels() {
         auto write_handle = graphics.get_config_panel().write_handle();
         write_handle->timestep_s = cfg.sim.timestep;
         write_handle->algorithm = cfg.sim.simtype_str;
+        write_handle->integrator = cfg.sim.integrator_str;
         write_handle->theta = cfg.sim.theta;
         write_handle->show_theta =
                 cfg.sim.simtype == Config::Simulation::SimType::BARNES_HUT
-                || cfg.sim.simtype == Config::Simulation::SimType::BARNES_HUT_GPU;
+                || cfg.sim.simtype == Config::Simulation::SimType::BARNES_HUT_GPU
+                || cfg.sim.simtype == Config::Simulation::SimType::FMM
+                || cfg.sim.simtype == Config::Simulation::SimType::TREE_PM;
         write_handle->softening_factor = cfg.sim.softening_factor;
         write_handle->threads = cfg.sim.threads;
         write_handle->show_threads = cfg.sim.simtype != Config::Simulation::SimType::BARNES_HUT_GPU;
@@ -112,6 +115,7 @@ void Controller::init_panels() {
         write_handle->fps = 0;
         write_handle->elapsed_s = 0;
         write_handle->simulated_time_s = 0;
+        write_handle->timestep_s = cfg.sim.timestep;
         write_handle->simulation_rate = std::numeric_limits<double>::quiet_NaN();
     }
 }
@@ -134,11 +138,16 @@ void Controller::update_panels() {
         write_handle->fps = graphics_stats.fps;
         write_handle->elapsed_s = sim_stats.real_elapsed_s;
         write_handle->simulated_time_s = sim_stats.simulated_elapsed_s;
-        write_handle->simulation_rate = sim_stats.ips * cfg.sim.timestep;
+        write_handle->timestep_s = sim_stats.timestep_s;
+        write_handle->simulation_rate = sim_stats.ips * sim_stats.timestep_s;
     }
 }
 
 void Controller::timestep_increase() {
+    if (cfg.sim.adaptive_timestep) {
+        Log::warning("The timestep is adaptive, it cannot be changed");
+        return;
+    }
     auto new_timestep = cfg.sim.timestep * Constants::Simulation::TIMESTEP_CHANGE_FACTOR;
     if (new_timestep > Constants::Simulation::TIMESTEP_RANGE.second) {
         Log::warning("Reached maximum timestep, cannot accelerate further");
@@ -150,6 +159,10 @@ void Controller::timestep_increase() {
 }
 
 void Controller::timestep_decrease() {
+    if (cfg.sim.adaptive_timestep) {
+        Log::warning("The timestep is adaptive, it cannot be changed");
+        return;
+    }
     auto new_timestep = cfg.sim.timestep / Constants::Simulation::TIMESTEP_CHANGE_FACTOR;
     if (new_timestep < Constants::Simulation::TIMESTEP_RANGE.first) {
         Log::warning("Reached minimum timestep, cannot decelerate further");
@@ -6,6 +6,7 @@
 struct ConfigDisplayedData {
     double timestep_s;
     std::string algorithm;
+    std::string integrator;
     double theta;
     bool show_theta;
     double softening_factor;
@@ -10,6 +10,7 @@ struct StatsDisplayedData {
     float fps;
     double elapsed_s;
     double simulated_time_s;
+    double timestep_s;
     double simulation_rate;
 };
 
@@ -12,6 +12,7 @@ void ConfigPanel::bake_impl() {
         "Configuration:\n"
         " Timestep:      {}\n"
         " Algorithm:     {}\n"
+        " Integrator:    {}\n"
         "{}" // Theta only relevant for Barnes-Hut
         " Soft. Factor:  {:.5f}\n"
         "{}" // Threads only relevant for threaded algorithms
@@ -22,6 +23,7 @@ void ConfigPanel::bake_impl() {
         " Max FPS:       {}",
         Log::Time::from(d.timestep_s),
         d.algorithm,
+        d.integrator,
         displayed_data.show_theta ? fmt::format(" Theta:         {}\n", d.theta) : "",
         d.softening_factor,
         displayed_data.show_threads ? fmt::format(" Threads (sim):  {}\n", d.threads) : "",
@@ -15,6 +15,7 @@ void StatsPanel::bake_impl() {
         " FPS:           {:.3f}\n"
         " Elapsed:       {}\n"
         " Sim. Time:     {}\n"
+        " Timestep:      {}\n"
         " Sim. Rate:     {}/s\n",
         d.iteration,
         d.iter_per_sec,
@@ -22,6 +23,7 @@ void StatsPanel::bake_impl() {
         d.fps,
         Log::Time::from(d.elapsed_s),
         Log::Time::from(d.simulated_time_s),
+        Log::Time::from(d.timestep_s),
         Log::Time::from(d.simulation_rate)
     );
     text.setString(txt);
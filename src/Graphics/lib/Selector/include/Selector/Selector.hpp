@@ -24,5 +24,5 @@ public:
 private:
     const Bodies& bodies;
     sf::VertexArray& body_vertex_array;
-    std::vector<uint32_t> selected_body_indices;
+    std::vector<uint32_t> selected_body_indices;  // in input order, like the vertices
 };
@@ -5,13 +5,13 @@
 
 Selector::Selector(const Bodies& bodies, sf::VertexArray& body_vertex_array)
         : bodies(bodies), body_vertex_array(body_vertex_array) {
-    assert(body_vertex_array.getVertexCount() == bodies.n);
-    selected_body_indices.reserve(bodies.n);
+    assert(body_vertex_array.getVertexCount() == bodies.input_n);
+    selected_body_indices.reserve(bodies.input_n);
 }
 
 void Selector::select(const sf::Rect<float>& region) {
     selected_body_indices.clear();
-    for (uint64_t i = 0; i < bodies.n; i++) {
+    for (uint64_t i = 0; i < bodies.input_n; i++) {
         if (region.contains(body_vertex_array[i].position)) {
             selected_body_indices.push_back(i);
             body_vertex_array[i].color = Constants::Graphics::SELECT_COLOR;
@@ -33,8 +33,15 @@ Selector::SelectionStats Selector::compute_stats() const {
     double total_mass = 0.0;
     sf::Vector2<double> center_of_mass{0.0, 0.0};
     sf::Vector2<double> weighted_velocity{0.0, 0.0};
-
-    for (const uint32_t index : selected_body_indices) {
+    uint32_t n = 0;
+
+    const auto layout_lock = bodies.lock_layout();
+    // An absorbed body is counted by the body it merged into
+    for (const uint32_t original_index : selected_body_indices) {
+        if (bodies.absorbed(original_index))
+            continue;
+        const uint64_t index = bodies.index_of(original_index);
+        n++;
         const double mass = bodies.mass(index);
         total_mass += mass;
         center_of_mass += mass * bodies.pos(index);
@@ -47,7 +54,7 @@ Selector::SelectionStats Selector::compute_stats() const {
     }
 
     return SelectionStats{
-        .n = static_cast<uint32_t>(selected_body_indices.size()),
+        .n = n,
         .total_mass = total_mass,
         .center_of_mass = center_of_mass,
         .weighted_velocity = weighted_velocity
@@ -121,8 +121,14 @@ void Graphics::draw_grid() {
 
 void Graphics::draw_bodies() {
     const uint64_t vertex_count = body_vertex_array.getVertexCount();
-    for (uint64_t i = 0; i < bodies.n; i++) {
-        body_vertex_array[i].position = vp.coords_to_pos_on_viewport(bodies.pos(i));
+    // Vertices follow the input order, which the selection relies on across body reorderings. An
+    // absorbed body is drawn on the body it merged into.
+    {
+        const auto layout_lock = bodies.lock_layout();
+        for (uint64_t i = 0; i < vertex_count; i++) {
+            body_vertex_array[i].position =
+                    vp.coords_to_pos_on_viewport(bodies.pos(bodies.index_of(i)));
+        }
     }
     window.draw(body_vertex_array, sf::RenderStates(&body_shader));
 }
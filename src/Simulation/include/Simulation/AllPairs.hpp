@@ -1,19 +1,25 @@
 #pragma once
 
-#include "Simulation/Simulation.hpp"
+#include "Simulation/ThreadedSimulation.hpp"
 
 
-class AllPairsSim : public Simulation {
+class AllPairsSim : public ThreadedSimulation {
 public:
     AllPairsSim(const Config::Simulation& sim_cfg, Bodies& bodies);
     ~AllPairsSim() override;
 
 private:
-    std::thread sim_thread;
+    // The bodies are cut into two blocks per thread, thread t owns the blocks 2t and 2t + 1
+    const uint32_t n_blocks;
+    std::atomic<uint64_t> row_counter{0};  // next unclaimed active body
 
-    void on_run() override;
-    void on_pause() override;
-    void simulate();
-    void update_positions();
-    void update_velocities();
+    void step(uint16_t thread_idx) override;
+    void block_step(uint16_t thread_idx);
+    std::pair<uint64_t, uint64_t> thread_range(uint16_t thread_idx) const;
+    std::pair<uint64_t, uint64_t> block_range(uint32_t block) const;
+    void evaluate_forces(uint16_t thread_idx);
+    void accumulate_forces(uint16_t thread_idx);
+    void accumulate_tile(uint32_t block_a, uint32_t block_b);
+    void update_active_accelerations();
+    void update_accelerations(uint64_t begin_idx, uint64_t end_idx);
 };
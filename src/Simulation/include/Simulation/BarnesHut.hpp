@@ -1,35 +1,118 @@
 #pragma once
 
-#include <barrier>
+#include "Quadtree/ForceTree.hpp"
+#include "Quadtree/MortonQuadtree.hpp"
+#include "Simulation/Binaries.hpp"
+#include "Simulation/Mergers.hpp"
+#include "Simulation/ThreadedSimulation.hpp"
 
-#include "Simulation/Simulation.hpp"
 
-
-class BarnesHut : public Simulation {
+class BarnesHut : public ThreadedSimulation {
 public:
     BarnesHut(const Config::Simulation& sim_cfg, Bodies& bodies);
     ~BarnesHut() override;
 
 private:
-    const uint16_t n_threads;
+    // Accepted nodes and opened leaf bodies of one group walk, all applied as point masses. With
+    // quadrupoles, the moments of the accepted nodes are added on top of their monopoles.
+    struct InteractionList {
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> mass;
+        std::vector<uint32_t> accepted_nodes;
+        std::vector<double> ax;  // accelerations of the group's bodies
+        std::vector<double> ay;
+        std::vector<double> far_ax;  // RESPA: far share of the accelerations of a split sum
+        std::vector<double> far_ay;
+
+        void clear();
+        void push_back(double x, double y, double mass);
+    };
+
+    struct alignas(64) ThreadStats {
+        uint64_t step_cost = 0;  // interactions computed in the current force evaluation
+    };
+
+    // RESPA: the interactions a force evaluation sums. Every interaction is split by a smooth
+    // kernel of its distance into a near share and a far share, which goes to far_ax/far_ay.
+    enum class Field : uint8_t { ALL, NEAR, SPLIT };
+
     const double theta_sq;
+    const Config::Simulation::TreeBuilder tree_builder;
+    const bool tree_refit;
+    const bool quadrupole;
+    const Config::Simulation::Walk walk;
+    const Config::Simulation::Scheduler scheduler;
+    const uint32_t reorder_interval;
+    const uint32_t respa_interval;
+    const double respa_split;  // split scale r_s (m)
+    const double respa_cutoff_sq;  // squared distance where the near share reaches zero
+    const double respa_cutoff_share;  // erfc split at the cutoff
     Quadtree qtree;
-    std::thread master;
-    std::vector<std::thread> workers;
-    const uint64_t worker_chunk;
-    const uint64_t master_offset;
-    std::barrier<> sync_point;
-    std::atomic<bool> worker_stop;
+    MortonQuadtree morton_tree;
+    ForceTree force_tree;
+    Binaries binaries;
+    Mergers mergers;
+    std::vector<uint32_t> groups;  // Walk::GROUP: ForceTree nodes sharing an interaction list
+    std::vector<uint32_t> active_groups;  // block timesteps: the groups holding an active body
+    std::vector<InteractionList> interaction_lists;  // one per thread
+    std::vector<InteractionList> far_lists;          // one per thread, Field::SPLIT
+    std::vector<ThreadStats> thread_stats;           // one per thread
+    std::vector<uint32_t> body_costs;  // interactions of every body in its last force evaluation
+    // Scheduler::COST_ZONES: previous cost of every acceleration phase item (body or group) in
+    // tree order, thread t owns the items [zone_begin[t], zone_begin[t + 1])
+    std::vector<uint64_t> item_costs;
+    std::vector<uint64_t> zone_begin;
+    // RESPA: far field accelerations of the last split evaluation, and the time the far field
+    // kicks of the current interval cover
+    std::vector<double> far_ax;
+    std::vector<double> far_ay;
+    double far_opening = 0.0;
+    double far_span = 0.0;
+    Field field = Field::ALL;  // of the current force evaluation
+    double cost_skew_sum = 0.0;
+    uint64_t force_evaluations = 0;
+    uint64_t total_interactions = 0;
+    std::atomic<uint64_t> acc_work_counter;  // Scheduler::DYNAMIC: next unclaimed item
+    StopWatch sw_reorder{StopWatch::State::PAUSED};
+    StopWatch sw_merge{StopWatch::State::PAUSED};
     StopWatch sw_tree{StopWatch::State::PAUSED};
-    StopWatch sw_vel{StopWatch::State::PAUSED};
-    StopWatch sw_pos{StopWatch::State::PAUSED};
-
-    void on_run() override;
-    void on_pause() override;
-    void simulate();
-    void worker_task(uint32_t worker_id);
-    void update_positions(uint64_t begin_idx, uint64_t end_idx);
-    void update_velocities(uint64_t begin_idx, uint64_t end_idx);
-    void update_velocity(uint64_t body_idx);
-    sf::Vector2<double> body_to_quad_force(uint64_t body_idx, const Quad& quad);
+    StopWatch sw_acc{StopWatch::State::PAUSED};
+    StopWatch sw_int{StopWatch::State::PAUSED};
+
+    void before_step() override;
+    void after_step() override;
+    void step(uint16_t thread_idx) override;
+    void block_step(uint16_t thread_idx);
+    void respa_step(uint16_t thread_idx);
+    void binary_step(uint16_t thread_idx);
+    void evaluate_forces(uint16_t thread_idx, Field field = Field::ALL);
+    void refresh_tree();
+    void reorder_bodies();
+    void merge_bodies();
+    void build_morton_tree(uint16_t thread_idx);
+    void compute_cost_zones();
+    void register_cost_skew();
+    std::pair<uint64_t, uint64_t> thread_range(uint64_t n_items, uint16_t thread_idx) const;
+    template <typename F>
+    void schedule(std::atomic<uint64_t>& work_counter, uint64_t n_items, uint64_t chunk,
+            uint16_t thread_idx, F&& update);
+    void acceleration_phase(uint16_t thread_idx);
+    template <typename F>
+    void integration_phase(uint16_t thread_idx, F&& update);
+    void far_kick(double timestep, uint64_t begin_idx, uint64_t end_idx);
+    uint64_t update_accelerations(uint64_t begin_idx, uint64_t end_idx);
+    uint32_t update_acceleration(uint64_t body_idx);
+    uint64_t update_group_accelerations(uint64_t group_begin, uint64_t group_end,
+            InteractionList& list, InteractionList& far_list);
+    uint64_t update_group_acceleration(uint32_t group_idx, InteractionList& list,
+            InteractionList& far_list);
+    void sum_interactions(const ForceTree::Node& group, InteractionList& list) const;
+    void sum_split_interactions(const ForceTree::Node& group, InteractionList& list) const;
+    double near_share(double soft_sq) const;
+    bool beyond_split(const ForceTree::Node& node, double dist_squared) const;
+    sf::Vector2<double> leaf_force(const ForceTree::Node& leaf, const sf::Vector2<double>& pos,
+            double mass) const;
+    void split_leaf_force(const ForceTree::Node& leaf, const sf::Vector2<double>& pos,
+            double mass, sf::Vector2<double>& F, sf::Vector2<double>& F_far) const;
 };
@@ -51,7 +51,6 @@ public:
     virtual ~BarnesHutCuda();
 
 private:
-    std::thread sim_thread;
     Box bounding_box;
     const double theta_sq;
     const int32_t max_quads;
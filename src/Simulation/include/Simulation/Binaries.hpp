@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "Body/Body.hpp"
+#include "Config/Config.hpp"
+#include "Quadtree/ForceTree.hpp"
+
+
+// Regularized tight binaries on top of the kick-drift-kick leapfrog. At the start of every step,
+// two bodies whose bound orbit stays within `binary_radius` and that are each other's nearest such
+// neighbour form a pair. A pair drifts as a composite particle: its center of mass in a straight
+// line, the separation along the exact Kepler orbit (Kepler.hpp), which is the closed form solution
+// of the Levi-Civita regularized motion. The kicks only carry the forces from the other bodies,
+// the pair's own softened force is taken out of the accelerations. So a pair may orbit many times
+// per step, and its members never come closer than the orbit allows, whatever the timestep.
+class Binaries {
+public:
+    struct Stats {
+        uint64_t steps = 0;
+        uint64_t pairs = 0;  // summed over the steps
+    };
+
+    Binaries(const Config::Simulation& sim_cfg, double epsilon_squared, uint64_t n_bodies);
+    bool enabled() const;
+    // Nearest bound neighbour within the radius of the bodies [begin_idx, end_idx), from a range
+    // walk over the tree of the current positions
+    void find_partners(const Bodies& bodies, const ForceTree& tree, uint64_t begin_idx,
+            uint64_t end_idx);
+    // Called by one thread once every partner is found, the other threads may only query the
+    // pairs after a barrier
+    void pair_up();
+    bool is_paired(uint64_t body_idx) const;
+    // Whether a node whose COM is `dist_squared` from a body may hold a body within the radius of
+    // it. The force walks open such nodes, so that a pair's own force is summed directly, as the
+    // kick takes it out, and not as part of a multipole.
+    bool may_hold_partner(const ForceTree::Node& node, double dist_squared) const;
+    uint64_t n_pairs() const;
+    // Kick of the pairs [pair_begin, pair_end), drift of the pairs [pair_begin, pair_end)
+    void kick(Bodies& bodies, double timestep, uint64_t pair_begin, uint64_t pair_end) const;
+    void drift(Bodies& bodies, double timestep, uint64_t pair_begin, uint64_t pair_end) const;
+    // Leapfrog kick then drift of the unpaired bodies of [begin_idx, end_idx)
+    void advance_unpaired(Bodies& bodies, double kick, double drift, uint64_t begin_idx,
+            uint64_t end_idx) const;
+    const Stats& get_stats() const;
+    uint64_t unconverged_drifts() const;  // whose Kepler solver did not converge, over the run
+
+private:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    const double radius_sq;
+    const double epsilon_squared;
+    std::vector<uint32_t> nearest;   // one per body, NONE without a bound neighbour in range
+    std::vector<uint32_t> partners;  // one per body, NONE if unpaired
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    Stats stats;
+    mutable std::atomic<uint64_t> n_unconverged_drifts{0};
+};
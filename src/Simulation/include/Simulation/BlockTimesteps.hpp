@@ -0,0 +1,58 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "Body/Body.hpp"
+#include "Config/Config.hpp"
+
+
+// Hierarchical block timesteps on top of the kick-drift-kick leapfrog. A body on level k takes
+// steps of timestep / 2^k, so an iteration is 2^max_level sub-steps of the finest step. Every body
+// drifts in every sub-step, which keeps the positions synchronized: a force tree only needs its
+// moments refreshed, not a rebuild. The bodies whose step ends with a sub-step are active, their
+// forces are evaluated and they take their closing kick. Unless the iteration ends there, they then
+// pick a new level, one whose steps start at this sub-step, and take their opening kick.
+// A body's level follows the acceleration criterion dt = sqrt(2 eta epsilon / |a|).
+class BlockTimesteps {
+public:
+    struct Stats {
+        uint64_t substeps = 0;
+        uint64_t active_bodies = 0;  // summed over the sub-steps
+    };
+
+    BlockTimesteps(const Config::Simulation& sim_cfg, double epsilon, uint64_t n_bodies);
+    bool enabled() const;
+    uint32_t substeps() const;  // per iteration
+    // Every body is synchronized at the start of an iteration. Picks the levels of the bodies
+    // [begin_idx, end_idx) and gives them their opening kick.
+    void start(Bodies& bodies, double timestep, uint64_t begin_idx, uint64_t end_idx);
+    void drift(Bodies& bodies, double timestep, uint64_t begin_idx, uint64_t end_idx) const;
+    // Called by one thread before the force evaluation of `substep`, the other threads may only
+    // query the active bodies after a barrier
+    void collect_active(uint32_t substep);
+    // Before the first iteration, so that every body gets its initial forces
+    void activate_all();
+    bool all_active() const;
+    bool is_active(uint64_t body_idx) const;
+    // Active items index the bodies when all of them are active, otherwise `active_bodies`
+    uint64_t n_active() const;
+    std::span<const uint32_t> active_bodies() const;
+    // Closing (and opening) kicks of the active items [begin, end)
+    void finish(Bodies& bodies, double timestep, uint64_t begin, uint64_t end);
+    // Follows Bodies::reorder, the new body i is the old body order[i]
+    void reorder(std::span<const uint32_t> order);
+    const Stats& get_stats() const;
+
+private:
+    const uint32_t max_level;
+    const double eta;
+    const double epsilon;
+    std::vector<uint8_t> levels;  // one per body
+    std::vector<uint32_t> active;
+    uint32_t substep = 0;  // the current one
+    bool all = true;
+    Stats stats;
+
+    uint8_t pick_level(double ax, double ay, double timestep) const;
+};
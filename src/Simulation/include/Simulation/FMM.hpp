@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Quadtree/ForceTree.hpp"
+#include "Simulation/ThreadedSimulation.hpp"
+
+
+// Fast multipole method on the quadtree. Every node carries a Cartesian multipole expansion about
+// its COM, built bottom-up (P2M, M2M). A dual tree walk turns every well separated pair of nodes
+// into a multipole-to-local translation (M2L) and every pair of nearby leaves into a direct sum
+// (P2P). The local expansions are then pushed down to the bodies (L2L, L2P).
+// The expansions are Taylor series of the Plummer softened 1/r potential in the plane, so the far
+// field obeys the same force law as the direct sums. Terms up to total degree `order` are kept.
+// With d the offset of a body from the COM, a multipole holds M_k = sum(m (-d)^k / k!) and a local
+// expansion the derivatives L_n of the potential at the COM (multi-indices k, n over x and y).
+class FMM : public ThreadedSimulation {
+public:
+    FMM(const Config::Simulation& sim_cfg, Bodies& bodies);
+    ~FMM() override;
+
+private:
+    struct alignas(64) ThreadStats {
+        uint64_t m2l = 0;        // multipole-to-local translations
+        uint64_t p2p_pairs = 0;  // body pairs summed directly
+        std::vector<double> derivatives;  // M2L scratch: derivatives of the kernel
+    };
+
+    const double theta_sq;
+    const uint32_t order;
+    const uint32_t n_coeffs;  // coefficients of an expansion of total degree `order`
+    const uint32_t reorder_interval;
+    Quadtree qtree;
+    ForceTree force_tree;
+    uint32_t max_subtree_bodies;
+    std::vector<uint32_t> subtrees;  // largest nodes holding at most `max_subtree_bodies` bodies
+    std::vector<double> multipoles;  // `n_coeffs` per ForceTree node, see `coeff_idx`
+    std::vector<double> locals;
+    std::vector<double> radii;  // distance from a node's COM to its farthest body
+    std::vector<double> acc_x;  // accelerations without G, in ForceTree body order
+    std::vector<double> acc_y;
+    std::vector<ThreadStats> thread_stats;  // one per thread
+    std::atomic<uint64_t> subtree_counter;  // next unclaimed subtree of the current pass
+    StopWatch sw_tree{StopWatch::State::PAUSED};
+    StopWatch sw_upward{StopWatch::State::PAUSED};
+    StopWatch sw_downward{StopWatch::State::PAUSED};
+    StopWatch sw_int{StopWatch::State::PAUSED};
+
+    void before_step() override;
+    void step(uint16_t thread_idx) override;
+    void evaluate_forces(uint16_t thread_idx);
+    void build_tree();
+    template <typename F>
+    void for_each_subtree(uint16_t thread_idx, F&& f);
+    void upward_pass(uint16_t thread_idx);
+    void downward_pass(uint16_t thread_idx);
+    void integration_phase(uint16_t thread_idx, uint32_t stage);
+    uint32_t coeff_idx(uint32_t x_degree, uint32_t y_degree) const;
+    void upward(uint32_t node_idx);
+    void upward_top(uint32_t node_idx);
+    void gather_children(uint32_t node_idx);
+    void interact(uint32_t target_idx, uint32_t source_idx, ThreadStats& stats);
+    void m2l(uint32_t target_idx, uint32_t source_idx, ThreadStats& stats);
+    void p2p(uint32_t target_idx, uint32_t source_idx, ThreadStats& stats);
+    void downward(uint32_t node_idx);
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Body/Body.hpp"
+#include "Config/Config.hpp"
+
+
+// A symplectic integrator, written as a step of alternating kicks and drifts in units of the
+// timestep: kick[0] drift[0] kick[1] ... drift[s - 1] kick[s], for s stages. The accelerations of
+// a kick are evaluated after the drift before it, so the first kick reuses those evaluated after
+// the last drift of the previous step (first same as last), it needs a force evaluation only on
+// the first step.
+//   Euler:       kick, drift. First order, the order of the Barnes-Hut engines. All Pairs used to
+//                drift first (the other symplectic Euler), it now kicks first as well.
+//   Leapfrog:    kick-drift-kick. Second order, one force evaluation per step.
+//   Yoshida4:    three leapfrogs of w1, w0, w1 timesteps (triple jump). Fourth order, three.
+//   Forest-Ruth: the position extended variant of Omelyan et al. (PEFRL), which has a much
+//                smaller error constant than the plain Forest-Ruth scheme (the same as Yoshida4).
+//                Fourth order, four.
+//   Wisdom-Holman: kick-drift-kick around the most massive (central) body. The drift moves every
+//                other body along its exact Kepler orbit around the central body, see Kepler.hpp,
+//                and the central body in a straight line. The kicks only carry the rest of the
+//                forces, so the timestep follows the perturbations rather than the orbits. Second
+//                order, one force evaluation.
+// The Wisdom-Holman split is heliocentric: it is time symmetric, but unlike the democratic
+// heliocentric split it is not exactly symplectic. It needs no sums over all the bodies, so every
+// thread advances its share on its own. The drift is written as two stages, the orbits around the
+// central body, then the central body itself, so that no thread moves it while others read it.
+class Integrator {
+public:
+    Integrator(Config::Simulation::Integrator type, const Bodies& bodies, double epsilon_squared);
+    uint32_t stages() const;
+    // Whether kick[0] is not empty, it uses the accelerations stored in the bodies
+    bool starts_with_kick() const;
+    // Whether the forces are evaluated after drift[stage], for the kick that follows it. After the
+    // last drift that includes kick[0] of the next step.
+    bool kicks_after(uint32_t stage) const;
+    uint32_t force_evaluations() const;  // per step
+    // kick[stage] and, unless it is the last kick, drift[stage] of the bodies [begin_idx, end_idx)
+    void advance(Bodies& bodies, uint32_t stage, double timestep, uint64_t begin_idx,
+            uint64_t end_idx) const;
+    // Wisdom-Holman: Kepler drifts whose solver did not converge, over the run
+    uint64_t unconverged_drifts() const;
+
+private:
+    static constexpr uint64_t NO_CENTRAL_BODY = std::numeric_limits<uint64_t>::max();
+
+    std::vector<double> kicks;  // s + 1 coefficients
+    std::vector<double> drifts;  // s coefficients
+    // Wisdom-Holman: original index of the central body
+    uint64_t central_body = NO_CENTRAL_BODY;
+    const double epsilon_squared;
+    mutable std::atomic<uint64_t> n_unconverged_drifts{0};
+
+    void central_kick(Bodies& bodies, double kick, uint64_t begin_idx, uint64_t end_idx) const;
+    void central_drift(Bodies& bodies, uint32_t stage, double drift, uint64_t begin_idx,
+            uint64_t end_idx) const;
+};
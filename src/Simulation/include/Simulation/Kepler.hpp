@@ -0,0 +1,12 @@
+#pragma once
+
+
+// Exact two-body motion, in universal variables so that elliptic, parabolic and hyperbolic orbits
+// share one solver (Danby, Fundamentals of Celestial Mechanics, ch. 6.9).
+namespace Kepler {
+// Advances the relative position (x, y) and velocity (vx, vy) of a body on its orbit around a
+// point mass by `timestep`, with mu = G (m1 + m2). An orbit through the origin is drifted in a
+// straight line. Returns false if the solver did not converge, the state is then advanced with its
+// last estimate, which lies within the bracket of the root.
+bool drift(double mu, double timestep, double& x, double& y, double& vx, double& vy);
+}  // namespace Kepler
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "Body/Body.hpp"
+#include "Config/Config.hpp"
+#include "Quadtree/ForceTree.hpp"
+
+
+// Merging of close encounters. After every step, each body looks for its nearest neighbour within
+// `merge_radius` with a range walk over the force tree, which holds the positions the step ended
+// with. Mutual nearest neighbours then merge into the heavier one (Bodies::merge), a body whose
+// nearest neighbour merges with a third one waits for the next step. A close pair is one body from
+// then on, so the body count, and with it the cost of a step, only decreases.
+class Mergers {
+public:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    struct Stats {
+        uint64_t merges = 0;  // absorbed bodies
+        uint64_t passes = 0;  // passes that merged bodies
+    };
+
+    Mergers(const Config::Simulation& sim_cfg, uint64_t n_bodies, uint64_t min_bodies);
+    bool enabled() const;
+    // Nearest neighbour within the radius of the bodies [begin_idx, end_idx)
+    void find_captures(const Bodies& bodies, const ForceTree& tree, uint64_t begin_idx,
+            uint64_t end_idx);
+    // Called by one thread once every neighbour is found, with the other threads parked. Returns
+    // whether bodies merged.
+    bool merge(Bodies& bodies);
+    // Former index -> index after the last merge, NONE for the absorbed bodies
+    std::span<const uint32_t> get_new_indices() const;
+    const Stats& get_stats() const;
+
+private:
+    const double radius_sq;
+    const uint64_t min_bodies;  // merging stops there
+    std::vector<uint32_t> nearest;  // one per body, NONE without a neighbour in range
+    std::vector<uint32_t> into;     // Bodies::merge
+    std::vector<uint32_t> new_idxs;
+    Stats stats;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Mesh/Mesh.hpp"
+#include "Simulation/ThreadedSimulation.hpp"
+
+
+// Particle-mesh gravity: the whole force comes from the Mesh, with the configured assignment
+// (CIC or TSC) and boundary. In the periodic mode the mesh is fixed to the initial bounding box
+// and the bodies wrap around it. In the isolated mode the mesh follows the bodies, the master
+// re-fits it when they leave it.
+class ParticleMesh : public ThreadedSimulation {
+public:
+    ParticleMesh(const Config::Simulation& sim_cfg, Bodies& bodies);
+    ~ParticleMesh() override;
+
+private:
+    Mesh mesh;
+    StopWatch sw_deposit{StopWatch::State::PAUSED};
+    StopWatch sw_solve{StopWatch::State::PAUSED};
+    StopWatch sw_interp{StopWatch::State::PAUSED};
+    StopWatch sw_int{StopWatch::State::PAUSED};
+
+    void step(uint16_t thread_idx) override;
+    void evaluate_forces(uint16_t thread_idx);
+    std::pair<uint64_t, uint64_t> thread_range(uint16_t thread_idx) const;
+    void interpolate(uint16_t thread_idx);
+    void integration_phase(uint16_t thread_idx, uint32_t stage);
+};
@@ -8,7 +8,10 @@
 #include "Constants/Constants.hpp"
 #include "Quadtree/Quadtree.hpp"
 #include "RLCaller/RLCaller.hpp"
+#include "Simulation/BlockTimesteps.hpp"
+#include "Simulation/Integrator.hpp"
 #include "StopWatch/StopWatch.hpp"
+#include "ThreadPool/ThreadPool.hpp"
 
 class Simulation {
 public:
@@ -19,9 +22,11 @@ public:
         float ips = 0.0;
         double real_elapsed_s = 0;
         double simulated_elapsed_s = 0;
+        double timestep_s = 0;  // of the last iteration
     };
 
-    Simulation(const Config::Simulation& sim_cfg, Bodies& bodies);
+    // `n_threads` sizes the thread pool, the number of threads the engine runs on
+    Simulation(const Config::Simulation& sim_cfg, Bodies& bodies, uint16_t n_threads);
     virtual ~Simulation();
     State get_state();
     Stats get_stats();
@@ -36,10 +41,18 @@ protected:
     const uint64_t max_iterations;
     std::atomic<double> requested_timestep;
     double timestep;
+    // Adaptive timestep: the next timestep follows the accelerations, requests are ignored
+    const bool adaptive_timestep;
+    const double timestep_eta;
+    double simulated_time = 0.0;
+    const Integrator integrator;
+    BlockTimesteps block_timesteps;  // replaces the integrator's stages when enabled
     uint64_t iteration = 0;
     std::atomic<bool> finished{false};
     std::atomic<bool> stop{false};
     BufferedMeanCalculator<float, 60> ips_calculator{};
+    // Lives as long as the simulation, its threads are parked while it is paused
+    ThreadPool thread_pool;
 
     static double compute_plummer_softening(const Bodies& bodies, double factor,
             double max_samples = Constants::Simulation::MAX_PAIRWISE_SOFTENING_COMPUTATIONS);
@@ -48,9 +61,13 @@ protected:
             const sf::Vector2<double>& pos_b);
 
     bool should_stop();
+    // Whether the step must evaluate the forces before the integrator's first kick, which only
+    // the first step has no accelerations for
+    bool needs_initial_forces() const;
     void post_iteration();
     virtual void on_run() = 0;
     virtual void on_pause() = 0;
+    // Plummer softened gravitational force on body a due to body b, the same law as GravityKernel
     sf::Vector2<double> force(const sf::Vector2<double>& pos_a, const sf::Vector2<double>& pos_b,
             double mass_a, double mass_b) const;
 
@@ -63,5 +80,6 @@ private:
     StopWatch sw{StopWatch::State::PAUSED};
     RLCaller stats_update_rate_limiter{Constants::Simulation::STATS_UPDATE_TIMER};
 
+    double adapted_timestep() const;
     void update_stats();
 };
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <barrier>
+#include <vector>
+
+#include "Simulation/Simulation.hpp"
+
+
+// An engine that runs on every thread of the pool. The last thread is the master, it runs the
+// iteration loop and the serial work between the steps, while the workers are parked on the
+// barrier. Every thread then runs the engine's step on its share of the work.
+class ThreadedSimulation : public Simulation {
+public:
+    ThreadedSimulation(const Config::Simulation& sim_cfg, Bodies& bodies);
+
+protected:
+    // Time spent in the parallel phases and waiting for the other threads after them
+    struct alignas(64) ThreadTimes {
+        StopWatch busy{StopWatch::State::PAUSED};
+        StopWatch idle{StopWatch::State::PAUSED};
+    };
+
+    const uint16_t n_threads;
+    std::vector<ThreadTimes> thread_times;  // one per thread
+    std::barrier<> sync_point;
+
+    void on_run() override;
+    void on_pause() override;
+    // Called by the master while the workers are parked, before and after every step
+    virtual void before_step() {}
+    virtual void after_step() {}
+    virtual void step(uint16_t thread_idx) = 0;
+    void wait_for_threads(uint16_t thread_idx);
+    void log_thread_times() const;
+
+private:
+    std::atomic<bool> worker_stop;
+
+    void simulate();
+    void worker_task(uint16_t thread_idx);
+};
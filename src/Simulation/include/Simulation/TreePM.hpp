@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Mesh/Mesh.hpp"
+#include "Quadtree/ForceTree.hpp"
+#include "Simulation/ThreadedSimulation.hpp"
+
+
+// TreePM: the Plummer softened potential 1 / R, R = sqrt(r^2 + eps^2), is split at the scale r_s
+// into a long range part erf(R / 2 r_s) / R, solved on the Mesh, and a short range part
+// erfc(R / 2 r_s) / R, summed with a Barnes-Hut group walk. The short range part falls off like
+// erfc, so the walk is cut off at R = `TREEPM_CUTOFF_SPLITS` r_s and only opens the nodes near a
+// group, whatever the size of the system.
+// The short range force is the softened force times a factor of R^2 / r_s^2, which is tabulated.
+// In the periodic mode the walk uses the nearest image of every node.
+class TreePM : public ThreadedSimulation {
+public:
+    TreePM(const Config::Simulation& sim_cfg, Bodies& bodies);
+    ~TreePM() override;
+
+private:
+    struct alignas(64) ThreadData {
+        // Sources of the current group walk, node COMs and bodies at their nearest image
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> mass;
+        uint64_t interactions = 0;
+    };
+
+    const double theta_sq;
+    const uint32_t reorder_interval;
+    Mesh mesh;
+    Quadtree qtree;
+    ForceTree force_tree;
+    std::vector<uint32_t> groups;
+    // Short range factor at evenly spaced R^2 / r_s^2 up to the cutoff
+    std::vector<double> short_range_table;
+    std::vector<ThreadData> thread_data;  // one per thread
+    std::atomic<uint64_t> group_counter;  // next unclaimed group of the short range phase
+    StopWatch sw_tree{StopWatch::State::PAUSED};
+    StopWatch sw_mesh{StopWatch::State::PAUSED};
+    StopWatch sw_short{StopWatch::State::PAUSED};
+    StopWatch sw_int{StopWatch::State::PAUSED};
+
+    void before_step() override;
+    void step(uint16_t thread_idx) override;
+    void evaluate_forces(uint16_t thread_idx);
+    void build_tree();
+    void mesh_phase(uint16_t thread_idx);
+    void short_range_phase(uint16_t thread_idx);
+    void update_group(uint32_t group_idx, ThreadData& data);
+    void integration_phase(uint16_t thread_idx, uint32_t stage);
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+
+namespace FFT {
+
+bool is_power_of_two(uint64_t n);
+
+// Iterative radix-2 complex FFT of a fixed power-of-two length. Neither direction is normalized,
+// an inverse after a forward transform scales the data by `size()`. A plan is read-only once
+// built, so threads may share it.
+class Plan {
+public:
+    explicit Plan(uint32_t n);
+    uint32_t size() const;
+    void forward(std::complex<double>* data) const;
+    void inverse(std::complex<double>* data) const;
+
+private:
+    const uint32_t n;
+    std::vector<std::complex<double>> twiddles;  // exp(-2 pi i k / n) for k < n / 2
+    std::vector<uint32_t> bit_reversed;
+
+    void transform(std::complex<double>* data, bool inverse) const;
+};
+
+}  // namespace FFT
@@ -0,0 +1,70 @@
+#include "FFT/FFT.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+
+namespace FFT {
+
+bool is_power_of_two(uint64_t n) {
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+Plan::Plan(uint32_t n) : n(n), twiddles(n / 2), bit_reversed(n) {
+    if (!is_power_of_two(n))
+        throw std::runtime_error("FFT length " + std::to_string(n) + " is not a power of two");
+
+    for (uint32_t k = 0; k < n / 2; k++) {
+        const double angle = -2.0 * M_PI * k / n;
+        twiddles[k] = {std::cos(angle), std::sin(angle)};
+    }
+    uint32_t bits = 0;
+    while ((1u << bits) < n) {
+        bits++;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t reversed = 0;
+        for (uint32_t b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1u) << (bits - 1 - b);
+        }
+        bit_reversed[i] = reversed;
+    }
+}
+
+uint32_t Plan::size() const {
+    return n;
+}
+
+void Plan::forward(std::complex<double>* data) const {
+    transform(data, false);
+}
+
+void Plan::inverse(std::complex<double>* data) const {
+    transform(data, true);
+}
+
+// Decimation in time: bit-reversal permutation, then log2(n) passes of butterflies whose span
+// doubles every pass. The inverse uses the conjugate twiddles.
+void Plan::transform(std::complex<double>* data, bool inverse) const {
+    for (uint32_t i = 0; i < n; i++) {
+        if (i < bit_reversed[i])
+            std::swap(data[i], data[bit_reversed[i]]);
+    }
+    for (uint32_t half = 1; half < n; half *= 2) {
+        const uint32_t twiddle_stride = n / (2 * half);
+        for (uint32_t begin = 0; begin < n; begin += 2 * half) {
+            for (uint32_t k = 0; k < half; k++) {
+                const std::complex<double> w = inverse ? std::conj(twiddles[k * twiddle_stride])
+                                                       : twiddles[k * twiddle_stride];
+                const std::complex<double> even = data[begin + k];
+                const std::complex<double> odd = data[begin + k + half] * w;
+                data[begin + k] = even + odd;
+                data[begin + k + half] = even - odd;
+            }
+        }
+    }
+}
+
+}  // namespace FFT
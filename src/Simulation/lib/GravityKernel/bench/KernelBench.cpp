@@ -0,0 +1,106 @@
+// Pair interaction throughput of every gravity kernel variant the CPU supports, checked against the
+// scalar kernel. Usage: n-body-2d-kernel-bench [n_targets] [n_sources] [reps]
+
+#include <algorithm>
+#include <cmath>
+#include <fmt/core.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GravityKernel/GravityKernel.hpp"
+#include "StopWatch/StopWatch.hpp"
+
+
+namespace {
+
+constexpr double EPSILON_SQ = 1e-6;
+
+struct Tile {
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> mass;
+
+    Gravity::Sources sources() const {
+        return {x.data(), y.data(), mass.data(), static_cast<uint32_t>(x.size())};
+    }
+};
+
+Tile make_tile(uint32_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    Tile tile{std::vector<double>(n), std::vector<double>(n), std::vector<double>(n)};
+    for (uint32_t i = 0; i < n; i++) {
+        tile.x[i] = unit(rng);
+        tile.y[i] = unit(rng);
+        tile.mass[i] = 1.0 + unit(rng);
+    }
+    return tile;
+}
+
+double max_rel_error(const std::vector<double>& values, const std::vector<double>& reference) {
+    double max_error = 0.0;
+    for (size_t i = 0; i < values.size(); i++) {
+        const double scale = std::max(std::abs(reference[i]), 1e-300);
+        max_error = std::max(max_error, std::abs(values[i] - reference[i]) / scale);
+    }
+    return max_error;
+}
+
+template <typename Kernel>
+void run(const char* name, Gravity::Isa isa, uint64_t pairs_per_rep, uint32_t reps,
+        const std::vector<double>& reference, Kernel&& kernel) {
+    std::vector<double> result;
+    StopWatch sw;
+    for (uint32_t rep = 0; rep < reps; rep++)
+        result = kernel(isa);
+    sw.pause();
+    const double seconds = sw.elapsed<std::chrono::seconds, 6>();
+    fmt::println("{:<18} {:<8} {:>9.1f} M pairs/s  [{}]  max rel error {:.2e}", name,
+            Gravity::isa_to_string(isa), pairs_per_rep * reps / seconds * 1e-6, sw,
+            max_rel_error(result, reference));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t n_targets = argc > 1 ? std::stoul(argv[1]) : 32;
+    const uint32_t n_sources = argc > 2 ? std::stoul(argv[2]) : 4096;
+    const uint32_t reps = argc > 3 ? std::stoul(argv[3]) : 2000;
+
+    const Tile targets = make_tile(n_targets, 42);
+    const Tile sources = make_tile(n_sources, 43);
+
+    // Accelerations of the target tile due to the source tile, concatenated as [ax..., ay...]
+    const auto accelerations = [&](Gravity::Isa isa) {
+        std::vector<double> a(2 * n_targets, 0.0);
+        Gravity::accelerations(isa, targets.x.data(), targets.y.data(), n_targets,
+                sources.sources(), EPSILON_SQ, a.data(), a.data() + n_targets);
+        return a;
+    };
+    // Forces between every target and the source tile, as [target fx, fy..., source fx, fy...]
+    const auto symmetric_forces = [&](Gravity::Isa isa) {
+        std::vector<double> f(2 * (n_targets + n_sources), 0.0);
+        double* source_fx = f.data() + 2 * n_targets;
+        double* source_fy = source_fx + n_sources;
+        for (uint32_t i = 0; i < n_targets; i++) {
+            Gravity::symmetric_forces(isa, targets.x[i], targets.y[i], targets.mass[i],
+                    sources.sources(), EPSILON_SQ, f[i], f[n_targets + i], source_fx, source_fy);
+        }
+        return f;
+    };
+
+    const uint64_t pairs_per_rep = static_cast<uint64_t>(n_targets) * n_sources;
+    const std::vector<double> accelerations_ref = accelerations(Gravity::Isa::SCALAR);
+    const std::vector<double> symmetric_forces_ref = symmetric_forces(Gravity::Isa::SCALAR);
+
+    fmt::println("{} targets x {} sources, {} reps, dispatching to {}", n_targets, n_sources, reps,
+            Gravity::isa_to_string(Gravity::isa()));
+    for (const auto isa : {Gravity::Isa::SCALAR, Gravity::Isa::AVX2, Gravity::Isa::AVX512}) {
+        if (!Gravity::is_supported(isa))
+            continue;
+        run("accelerations", isa, pairs_per_rep, reps, accelerations_ref, accelerations);
+        run("symmetric_forces", isa, pairs_per_rep, reps, symmetric_forces_ref, symmetric_forces);
+    }
+    return 0;
+}
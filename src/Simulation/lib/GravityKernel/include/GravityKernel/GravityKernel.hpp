@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+
+// Plummer softened gravity between SoA point masses. All results are without the G factor.
+// Sources at the exact position of a target are skipped, so a body may be part of its own sources.
+namespace Gravity {
+enum class Isa : uint8_t { SCALAR, AVX2, AVX512 };
+
+struct Sources {
+    const double* x;
+    const double* y;
+    const double* mass;
+    uint32_t n;
+};
+
+// Widest instruction set supported by the CPU, used when no Isa is passed
+Isa isa();
+bool is_supported(Isa isa);
+std::string_view isa_to_string(Isa isa);
+
+// For every target i: (ax[i], ay[i]) += sum_j mass_j * (r_j - r_i) / (|r_j - r_i|^2 + eps_sq)^1.5
+void accelerations(const double* target_x, const double* target_y, uint32_t n_targets,
+        const Sources& sources, double eps_sq, double* ax, double* ay);
+void accelerations(Isa isa, const double* target_x, const double* target_y, uint32_t n_targets,
+        const Sources& sources, double eps_sq, double* ax, double* ay);
+
+// Forces between one body and every source, computed once per pair: the force on the body is added
+// to (fx, fy), its opposite to (source_fx[j], source_fy[j]).
+void symmetric_forces(double x, double y, double mass, const Sources& sources, double eps_sq,
+        double& fx, double& fy, double* source_fx, double* source_fy);
+void symmetric_forces(Isa isa, double x, double y, double mass, const Sources& sources,
+        double eps_sq, double& fx, double& fy, double* source_fx, double* source_fy);
+}  // namespace Gravity
@@ -0,0 +1,127 @@
+#include "GravityKernel/GravityKernel.hpp"
+
+#include <cmath>
+
+#include "GravityKernelImpl.hpp"
+
+using namespace Gravity;
+
+using AccelerationsFn = decltype(&Impl::accelerations_scalar);
+using SymmetricForcesFn = decltype(&Impl::symmetric_forces_scalar);
+
+static Isa detect_isa() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return Isa::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return Isa::AVX2;
+    return Isa::SCALAR;
+}
+
+static AccelerationsFn accelerations_fn(Isa isa) {
+    switch (isa) {
+    case Isa::AVX512:
+        return Impl::accelerations_avx512;
+    case Isa::AVX2:
+        return Impl::accelerations_avx2;
+    default:
+        return Impl::accelerations_scalar;
+    }
+}
+
+static SymmetricForcesFn symmetric_forces_fn(Isa isa) {
+    switch (isa) {
+    case Isa::AVX512:
+        return Impl::symmetric_forces_avx512;
+    case Isa::AVX2:
+        return Impl::symmetric_forces_avx2;
+    default:
+        return Impl::symmetric_forces_scalar;
+    }
+}
+
+// Resolved once, the hot paths only pay for an indirect call
+static const Isa best_isa = detect_isa();
+static const AccelerationsFn best_accelerations = accelerations_fn(best_isa);
+static const SymmetricForcesFn best_symmetric_forces = symmetric_forces_fn(best_isa);
+
+Isa Gravity::isa() {
+    return best_isa;
+}
+
+bool Gravity::is_supported(Isa isa) {
+    return static_cast<uint8_t>(isa) <= static_cast<uint8_t>(best_isa);
+}
+
+std::string_view Gravity::isa_to_string(Isa isa) {
+    switch (isa) {
+    case Isa::SCALAR:
+        return "Scalar";
+    case Isa::AVX2:
+        return "AVX2";
+    case Isa::AVX512:
+        return "AVX-512";
+    }
+    return "";
+}
+
+void Gravity::accelerations(const double* target_x, const double* target_y, uint32_t n_targets,
+        const Sources& sources, double eps_sq, double* ax, double* ay) {
+    best_accelerations(target_x, target_y, n_targets, sources, eps_sq, ax, ay);
+}
+
+void Gravity::accelerations(Isa isa, const double* target_x, const double* target_y,
+        uint32_t n_targets, const Sources& sources, double eps_sq, double* ax, double* ay) {
+    accelerations_fn(isa)(target_x, target_y, n_targets, sources, eps_sq, ax, ay);
+}
+
+void Gravity::symmetric_forces(double x, double y, double mass, const Sources& sources,
+        double eps_sq, double& fx, double& fy, double* source_fx, double* source_fy) {
+    best_symmetric_forces(x, y, mass, sources, eps_sq, fx, fy, source_fx, source_fy);
+}
+
+void Gravity::symmetric_forces(Isa isa, double x, double y, double mass, const Sources& sources,
+        double eps_sq, double& fx, double& fy, double* source_fx, double* source_fy) {
+    symmetric_forces_fn(isa)(x, y, mass, sources, eps_sq, fx, fy, source_fx, source_fy);
+}
+
+void Impl::accelerations_scalar(const double* target_x, const double* target_y,
+        uint32_t n_targets, const Sources& sources, double eps_sq, double* ax, double* ay) {
+    for (uint32_t i = 0; i < n_targets; i++) {
+        const double x = target_x[i];
+        const double y = target_y[i];
+        double sum_x = 0;
+        double sum_y = 0;
+        for (uint32_t j = 0; j < sources.n; j++) {
+            const double dx = sources.x[j] - x;
+            const double dy = sources.y[j] - y;
+            const double dist_sq = dx * dx + dy * dy;
+            const double inv_dist = 1.0 / std::sqrt(dist_sq + eps_sq);
+            const double s = dist_sq > 0.0 ? sources.mass[j] * inv_dist * inv_dist * inv_dist : 0.0;
+            sum_x += s * dx;
+            sum_y += s * dy;
+        }
+        ax[i] += sum_x;
+        ay[i] += sum_y;
+    }
+}
+
+void Impl::symmetric_forces_scalar(double x, double y, double mass, const Sources& sources,
+        double eps_sq, double& fx, double& fy, double* source_fx, double* source_fy) {
+    double sum_x = 0;
+    double sum_y = 0;
+    for (uint32_t j = 0; j < sources.n; j++) {
+        const double dx = sources.x[j] - x;
+        const double dy = sources.y[j] - y;
+        const double dist_sq = dx * dx + dy * dy;
+        const double inv_dist = 1.0 / std::sqrt(dist_sq + eps_sq);
+        const double s =
+                dist_sq > 0.0 ? mass * sources.mass[j] * inv_dist * inv_dist * inv_dist : 0.0;
+        sum_x += s * dx;
+        sum_y += s * dy;
+        source_fx[j] -= s * dx;
+        source_fy[j] -= s * dy;
+    }
+    fx += sum_x;
+    fy += sum_y;
+}
@@ -0,0 +1,80 @@
+#include <immintrin.h>
+
+#include "GravityKernelImpl.hpp"
+
+using namespace Gravity;
+
+static constexpr uint32_t LANES = 4;
+
+// All ones in the first `remaining` lanes
+static __m256i tail_mask(uint32_t remaining) {
+    const __m256i lane = _mm256_setr_epi64x(0, 1, 2, 3);
+    return _mm256_cmpgt_epi64(_mm256_set1_epi64x(remaining), lane);
+}
+
+// mass / (dist_sq + eps_sq)^1.5, zero for sources at the target position and for inactive lanes.
+// The AVX2 rsqrt estimate is single precision only and overflows for astronomical distances, so
+// the exact sqrt and division are used instead.
+static __m256d pair_scale(__m256d dx, __m256d dy, __m256d mass, __m256d eps_sq) {
+    const __m256d dist_sq = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+    const __m256d valid = _mm256_cmp_pd(dist_sq, _mm256_setzero_pd(), _CMP_GT_OQ);
+    const __m256d inv_dist =
+            _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_sqrt_pd(_mm256_add_pd(dist_sq, eps_sq)));
+    const __m256d inv_dist_cb = _mm256_mul_pd(inv_dist, _mm256_mul_pd(inv_dist, inv_dist));
+    return _mm256_and_pd(valid, _mm256_mul_pd(mass, inv_dist_cb));
+}
+
+static double reduce_add(__m256d v) {
+    const __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+void Impl::accelerations_avx2(const double* target_x, const double* target_y, uint32_t n_targets,
+        const Sources& sources, double eps_sq, double* ax, double* ay) {
+    const __m256d eps_sq_v = _mm256_set1_pd(eps_sq);
+    for (uint32_t i = 0; i < n_targets; i++) {
+        const __m256d x = _mm256_set1_pd(target_x[i]);
+        const __m256d y = _mm256_set1_pd(target_y[i]);
+        __m256d sum_x = _mm256_setzero_pd();
+        __m256d sum_y = _mm256_setzero_pd();
+        for (uint32_t j = 0; j < sources.n; j += LANES) {
+            // Masked out lanes load a zero mass, which zeroes their contribution
+            const __m256i active = tail_mask(sources.n - j);
+            const __m256d dx = _mm256_sub_pd(_mm256_maskload_pd(sources.x + j, active), x);
+            const __m256d dy = _mm256_sub_pd(_mm256_maskload_pd(sources.y + j, active), y);
+            const __m256d mass = _mm256_maskload_pd(sources.mass + j, active);
+            const __m256d s = pair_scale(dx, dy, mass, eps_sq_v);
+            sum_x = _mm256_fmadd_pd(s, dx, sum_x);
+            sum_y = _mm256_fmadd_pd(s, dy, sum_y);
+        }
+        ax[i] += reduce_add(sum_x);
+        ay[i] += reduce_add(sum_y);
+    }
+}
+
+void Impl::symmetric_forces_avx2(double x, double y, double mass, const Sources& sources,
+        double eps_sq, double& fx, double& fy, double* source_fx, double* source_fy) {
+    const __m256d eps_sq_v = _mm256_set1_pd(eps_sq);
+    const __m256d x_v = _mm256_set1_pd(x);
+    const __m256d y_v = _mm256_set1_pd(y);
+    const __m256d mass_v = _mm256_set1_pd(mass);
+    __m256d sum_x = _mm256_setzero_pd();
+    __m256d sum_y = _mm256_setzero_pd();
+    for (uint32_t j = 0; j < sources.n; j += LANES) {
+        const __m256i active = tail_mask(sources.n - j);
+        const __m256d dx = _mm256_sub_pd(_mm256_maskload_pd(sources.x + j, active), x_v);
+        const __m256d dy = _mm256_sub_pd(_mm256_maskload_pd(sources.y + j, active), y_v);
+        const __m256d source_mass = _mm256_maskload_pd(sources.mass + j, active);
+        const __m256d s = _mm256_mul_pd(mass_v, pair_scale(dx, dy, source_mass, eps_sq_v));
+        const __m256d f_x = _mm256_mul_pd(s, dx);
+        const __m256d f_y = _mm256_mul_pd(s, dy);
+        sum_x = _mm256_add_pd(sum_x, f_x);
+        sum_y = _mm256_add_pd(sum_y, f_y);
+        _mm256_maskstore_pd(source_fx + j, active,
+                _mm256_sub_pd(_mm256_maskload_pd(source_fx + j, active), f_x));
+        _mm256_maskstore_pd(source_fy + j, active,
+                _mm256_sub_pd(_mm256_maskload_pd(source_fy + j, active), f_y));
+    }
+    fx += reduce_add(sum_x);
+    fy += reduce_add(sum_y);
+}
@@ -0,0 +1,80 @@
+#include <immintrin.h>
+
+#include "GravityKernelImpl.hpp"
+
+using namespace Gravity;
+
+static constexpr uint32_t LANES = 8;
+
+static __mmask8 tail_mask(uint32_t remaining) {
+    return remaining >= LANES ? __mmask8(0xFF) : __mmask8((1u << remaining) - 1);
+}
+
+// 1 / sqrt(x), the 14 bit estimate is refined by two Newton-Raphson steps to full double precision
+static __m512d inv_sqrt(__m512d x) {
+    const __m512d half_x = _mm512_mul_pd(x, _mm512_set1_pd(0.5));
+    const __m512d three_halves = _mm512_set1_pd(1.5);
+    __m512d y = _mm512_rsqrt14_pd(x);
+    y = _mm512_mul_pd(y, _mm512_fnmadd_pd(half_x, _mm512_mul_pd(y, y), three_halves));
+    y = _mm512_mul_pd(y, _mm512_fnmadd_pd(half_x, _mm512_mul_pd(y, y), three_halves));
+    return y;
+}
+
+// mass / (dist_sq + eps_sq)^1.5, zero for sources at the target position and for inactive lanes
+static __m512d pair_scale(__m512d dx, __m512d dy, __m512d mass, __m512d eps_sq, __mmask8 active) {
+    const __m512d dist_sq = _mm512_fmadd_pd(dx, dx, _mm512_mul_pd(dy, dy));
+    const __mmask8 valid =
+            _mm512_mask_cmp_pd_mask(active, dist_sq, _mm512_setzero_pd(), _CMP_GT_OQ);
+    const __m512d inv_dist = inv_sqrt(_mm512_add_pd(dist_sq, eps_sq));
+    const __m512d inv_dist_cb = _mm512_mul_pd(inv_dist, _mm512_mul_pd(inv_dist, inv_dist));
+    return _mm512_maskz_mul_pd(valid, mass, inv_dist_cb);
+}
+
+void Impl::accelerations_avx512(const double* target_x, const double* target_y,
+        uint32_t n_targets, const Sources& sources, double eps_sq, double* ax, double* ay) {
+    const __m512d eps_sq_v = _mm512_set1_pd(eps_sq);
+    for (uint32_t i = 0; i < n_targets; i++) {
+        const __m512d x = _mm512_set1_pd(target_x[i]);
+        const __m512d y = _mm512_set1_pd(target_y[i]);
+        __m512d sum_x = _mm512_setzero_pd();
+        __m512d sum_y = _mm512_setzero_pd();
+        for (uint32_t j = 0; j < sources.n; j += LANES) {
+            const __mmask8 active = tail_mask(sources.n - j);
+            const __m512d dx = _mm512_sub_pd(_mm512_maskz_loadu_pd(active, sources.x + j), x);
+            const __m512d dy = _mm512_sub_pd(_mm512_maskz_loadu_pd(active, sources.y + j), y);
+            const __m512d mass = _mm512_maskz_loadu_pd(active, sources.mass + j);
+            const __m512d s = pair_scale(dx, dy, mass, eps_sq_v, active);
+            sum_x = _mm512_fmadd_pd(s, dx, sum_x);
+            sum_y = _mm512_fmadd_pd(s, dy, sum_y);
+        }
+        ax[i] += _mm512_reduce_add_pd(sum_x);
+        ay[i] += _mm512_reduce_add_pd(sum_y);
+    }
+}
+
+void Impl::symmetric_forces_avx512(double x, double y, double mass, const Sources& sources,
+        double eps_sq, double& fx, double& fy, double* source_fx, double* source_fy) {
+    const __m512d eps_sq_v = _mm512_set1_pd(eps_sq);
+    const __m512d x_v = _mm512_set1_pd(x);
+    const __m512d y_v = _mm512_set1_pd(y);
+    const __m512d mass_v = _mm512_set1_pd(mass);
+    __m512d sum_x = _mm512_setzero_pd();
+    __m512d sum_y = _mm512_setzero_pd();
+    for (uint32_t j = 0; j < sources.n; j += LANES) {
+        const __mmask8 active = tail_mask(sources.n - j);
+        const __m512d dx = _mm512_sub_pd(_mm512_maskz_loadu_pd(active, sources.x + j), x_v);
+        const __m512d dy = _mm512_sub_pd(_mm512_maskz_loadu_pd(active, sources.y + j), y_v);
+        const __m512d source_mass = _mm512_maskz_loadu_pd(active, sources.mass + j);
+        const __m512d s = _mm512_mul_pd(mass_v, pair_scale(dx, dy, source_mass, eps_sq_v, active));
+        const __m512d f_x = _mm512_mul_pd(s, dx);
+        const __m512d f_y = _mm512_mul_pd(s, dy);
+        sum_x = _mm512_add_pd(sum_x, f_x);
+        sum_y = _mm512_add_pd(sum_y, f_y);
+        _mm512_mask_storeu_pd(source_fx + j, active,
+                _mm512_sub_pd(_mm512_maskz_loadu_pd(active, source_fx + j), f_x));
+        _mm512_mask_storeu_pd(source_fy + j, active,
+                _mm512_sub_pd(_mm512_maskz_loadu_pd(active, source_fy + j), f_y));
+    }
+    fx += _mm512_reduce_add_pd(sum_x);
+    fy += _mm512_reduce_add_pd(sum_y);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "GravityKernel/GravityKernel.hpp"
+
+
+// Per instruction set implementations, each one lives in a translation unit compiled for its target
+namespace Gravity::Impl {
+void accelerations_scalar(const double* target_x, const double* target_y, uint32_t n_targets,
+        const Sources& sources, double eps_sq, double* ax, double* ay);
+void symmetric_forces_scalar(double x, double y, double mass, const Sources& sources,
+        double eps_sq, double& fx, double& fy, double* source_fx, double* source_fy);
+
+void accelerations_avx2(const double* target_x, const double* target_y, uint32_t n_targets,
+        const Sources& sources, double eps_sq, double* ax, double* ay);
+void symmetric_forces_avx2(double x, double y, double mass, const Sources& sources,
+        double eps_sq, double& fx, double& fy, double* source_fx, double* source_fy);
+
+void accelerations_avx512(const double* target_x, const double* target_y, uint32_t n_targets,
+        const Sources& sources, double eps_sq, double* ax, double* ay);
+void symmetric_forces_avx512(double x, double y, double mass, const Sources& sources,
+        double eps_sq, double& fx, double& fy, double* source_fx, double* source_fy);
+}  // namespace Gravity::Impl
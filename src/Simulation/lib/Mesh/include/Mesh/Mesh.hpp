@@ -0,0 +1,136 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "Body/Body.hpp"
+#include "Config/Config.hpp"
+#include "FFT/FFT.hpp"
+#include "SFML/System/Vector2.hpp"
+
+
+// Gravity of the bodies on a square N x N mesh. The masses are deposited with CIC or TSC weights,
+// the potential is the convolution of the mesh with a Green's function, done with FFTs, and the
+// accelerations are its fourth order finite difference gradient, interpolated back to any point
+// with the deposit weights.
+// The Green's function is the Plummer softened 1/r potential of the engines. With a split scale
+// r_s it is only the long range part erf(R / 2 r_s) / R, R = sqrt(r^2 + eps^2), the rest is left
+// to a short range solver. Its spectrum is then corrected for the smoothing of the assignment.
+// Periodic: the mesh covers a fixed box, the Green's function is given by its Fourier transform
+// with the mean density dropped.
+// Isolated: the mesh is zero padded to 2N x 2N (Hockney) and transformed from real space, it
+// follows the bodies: every thread `track`s its share after a drift and `refit` moves the mesh
+// when they left it.
+// The work of a step is split over `n_threads` threads: every thread calls each phase with its
+// index and the phases must be separated by barriers, which the `wait` callbacks provide.
+class Mesh {
+public:
+    enum class Assignment : uint8_t { CIC, TSC };
+    enum class Boundary : uint8_t { PERIODIC, ISOLATED };
+
+    struct Box {
+        double min_x, min_y, max_x, max_y;
+
+        static Box empty();
+        void add(double x, double y);
+        void add(const Box& box);
+    };
+
+    Mesh(uint32_t grid_n, Assignment assignment, Boundary boundary, double epsilon_squared,
+            double split_cells, uint16_t n_threads, uint64_t n_bodies);
+    // The grid, assignment, boundary and thread count of the simulation config
+    Mesh(const Config::Simulation& sim_cfg, double epsilon_squared, double split_cells,
+            uint64_t n_bodies);
+    // Centers the mesh on all the bodies
+    void fit(const Bodies& bodies);
+    // After a drift of the thread's share of the bodies. Periodic: wraps them around the box.
+    // Isolated: records their bounding box for `refit`.
+    void track(Bodies& bodies, uint16_t thread_idx);
+    // Isolated: re-fits the mesh when the tracked bodies left it, on one thread between barriers
+    void refit();
+    // Deposits the masses of the bodies, two waits inside
+    template <typename Wait>
+    void deposit(const Bodies& bodies, uint16_t thread_idx, Wait&& wait);
+    // Computes the mesh accelerations from the deposit, three waits inside
+    template <typename Wait>
+    void solve(uint16_t thread_idx, Wait&& wait);
+    // Mesh acceleration without G at a point, valid after a solve
+    sf::Vector2<double> acceleration(double x, double y) const;
+    // Periodic: brings a point back into the box
+    void wrap(double& x, double& y) const;
+    bool is_periodic() const;
+    uint32_t size() const;
+    double cell_size() const;
+    double box_side() const;
+    double split_scale() const;  // r_s, 0 when the Green's function is not split
+    uint64_t fit_count() const;
+
+private:
+    struct alignas(64) ThreadData {
+        std::vector<uint64_t> strip_counts;  // bodies of the thread per strip
+        std::vector<uint64_t> strip_begin;   // first index of every strip in `strip_bodies`
+        std::vector<std::complex<double>> columns;  // a block of grid columns being transformed
+        Box bounds;  // bounding box of the thread's bodies after the last drift
+    };
+
+    const bool isolated;
+    const bool tsc;
+    const double epsilon_squared;
+    const double split_cells;  // r_s in cells
+    const uint16_t n_threads;
+    const uint32_t grid_n;     // mesh cells per side
+    const uint32_t padded_n;   // FFT size per side, 2 * grid_n when isolated
+    const uint32_t n_strips;   // row strips of the deposit, an even count of at least 2 rows each
+    const FFT::Plan plan;
+    double origin_x = 0.0;     // lower corner of the mesh
+    double origin_y = 0.0;
+    double cell = 0.0;         // cell size
+    uint64_t fits_done = 0;
+    std::vector<double> density;  // deposited mass per cell, grid_n x grid_n
+    std::vector<std::complex<double>> grid;  // padded_n x padded_n, the FFT work grid
+    std::vector<double> green;  // spectrum of the Green's function, already divided by the sizes
+    std::vector<double> grid_ax;  // accelerations without G per cell, grid_n x grid_n
+    std::vector<double> grid_ay;
+    std::vector<uint64_t> strip_bodies;  // body indices grouped by strip
+    std::vector<ThreadData> thread_data;  // one per thread
+
+    // Centers the mesh on the box with some slack around it
+    void fit(const Box& box);
+    // Isolated: whether the bodies are inside the margins and the cells are at most twice the size
+    // a new fit would give them
+    bool fits(const Box& box) const;
+    std::pair<uint64_t, uint64_t> thread_range(uint64_t n, uint16_t thread_idx) const;
+    void compute_green();
+    void deconvolve();
+    uint32_t strip_of(double y) const;
+    void count_strips(const Bodies& bodies, uint16_t thread_idx);
+    void scatter_strips(const Bodies& bodies, uint16_t thread_idx);
+    void deposit_strips(const Bodies& bodies, uint16_t thread_idx, uint32_t parity);
+    void forward_rows(uint16_t thread_idx);
+    void convolve_columns(uint16_t thread_idx);
+    void inverse_rows(uint16_t thread_idx);
+    void differentiate(uint16_t thread_idx);
+};
+
+template <typename Wait>
+void Mesh::deposit(const Bodies& bodies, uint16_t thread_idx, Wait&& wait) {
+    count_strips(bodies, thread_idx);
+    wait();
+    scatter_strips(bodies, thread_idx);
+    wait();
+    deposit_strips(bodies, thread_idx, 0);
+    wait();
+    deposit_strips(bodies, thread_idx, 1);
+}
+
+template <typename Wait>
+void Mesh::solve(uint16_t thread_idx, Wait&& wait) {
+    forward_rows(thread_idx);
+    wait();
+    convolve_columns(thread_idx);
+    wait();
+    inverse_rows(thread_idx);
+    wait();
+    differentiate(thread_idx);
+}
@@ -0,0 +1,436 @@
+#include "Mesh/Mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "Constants/Constants.hpp"
+
+
+// Grid columns gathered per FFT block, a cache line of complex values per grid row
+constexpr uint32_t COLUMN_BLOCK = 4;
+
+// Assignment weights of a position along one axis, in cells with cell centers at i + 0.5. The
+// cells first, ..., first + width - 1 receive the weights (with wrapped indices).
+struct Stencil {
+    int32_t first;
+    uint32_t width;
+    double w[3];
+};
+
+static Stencil stencil(double u, bool tsc) {
+    if (tsc) {
+        const double cell = std::floor(u);
+        const double d = u - cell - 0.5;
+        return {static_cast<int32_t>(cell) - 1, 3,
+                {0.5 * (0.5 - d) * (0.5 - d), 0.75 - d * d, 0.5 * (0.5 + d) * (0.5 + d)}};
+    }
+    const double t = u - 0.5;
+    const double cell = std::floor(t);
+    const double f = t - cell;
+    return {static_cast<int32_t>(cell), 2, {1.0 - f, f, 0.0}};
+}
+
+static Mesh::Assignment assignment_of(const Config::Simulation& sim_cfg) {
+    return sim_cfg.pm_assignment == Config::Simulation::PMAssignment::TSC ? Mesh::Assignment::TSC
+                                                                          : Mesh::Assignment::CIC;
+}
+
+static Mesh::Boundary boundary_of(const Config::Simulation& sim_cfg) {
+    return sim_cfg.pm_boundary == Config::Simulation::PMBoundary::ISOLATED
+                   ? Mesh::Boundary::ISOLATED
+                   : Mesh::Boundary::PERIODIC;
+}
+
+Mesh::Box Mesh::Box::empty() {
+    return {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(),
+            std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+}
+
+void Mesh::Box::add(double x, double y) {
+    min_x = std::min(min_x, x);
+    min_y = std::min(min_y, y);
+    max_x = std::max(max_x, x);
+    max_y = std::max(max_y, y);
+}
+
+void Mesh::Box::add(const Box& box) {
+    add(box.min_x, box.min_y);
+    add(box.max_x, box.max_y);
+}
+
+Mesh::Mesh(uint32_t grid_n, Assignment assignment, Boundary boundary, double epsilon_squared,
+        double split_cells, uint16_t n_threads, uint64_t n_bodies)
+        : isolated(boundary == Boundary::ISOLATED), tsc(assignment == Assignment::TSC),
+          epsilon_squared(epsilon_squared), split_cells(split_cells), n_threads(n_threads),
+          grid_n(grid_n), padded_n(isolated ? 2 * grid_n : grid_n),
+          n_strips(2 * std::min<uint32_t>(n_threads, grid_n / 4)), plan(padded_n),
+          density(static_cast<uint64_t>(grid_n) * grid_n),
+          grid(static_cast<uint64_t>(padded_n) * padded_n),
+          green(static_cast<uint64_t>(padded_n) * padded_n),
+          grid_ax(static_cast<uint64_t>(grid_n) * grid_n),
+          grid_ay(static_cast<uint64_t>(grid_n) * grid_n), strip_bodies(n_bodies),
+          thread_data(n_threads) {
+    if (!FFT::is_power_of_two(grid_n) || grid_n < 16)
+        throw std::runtime_error("Mesh size " + std::to_string(grid_n)
+                                 + " is not a power of two of at least 16");
+
+    for (ThreadData& data : thread_data) {
+        data.strip_counts.resize(n_strips);
+        data.strip_begin.resize(n_strips + 1);
+        data.columns.resize(COLUMN_BLOCK * padded_n);
+    }
+}
+
+Mesh::Mesh(const Config::Simulation& sim_cfg, double epsilon_squared, double split_cells,
+        uint64_t n_bodies)
+        : Mesh(sim_cfg.pm_grid, assignment_of(sim_cfg), boundary_of(sim_cfg), epsilon_squared,
+                  split_cells, sim_cfg.threads, n_bodies) {}
+
+void Mesh::fit(const Bodies& bodies) {
+    Box box = Box::empty();
+    for (uint64_t i = 0; i < bodies.n; i++) {
+        box.add(bodies.x()[i], bodies.y()[i]);
+    }
+    for (ThreadData& data : thread_data) {
+        data.bounds = box;
+    }
+    fit(box);
+}
+
+void Mesh::track(Bodies& bodies, uint16_t thread_idx) {
+    const auto [begin_idx, end_idx] = thread_range(bodies.n, thread_idx);
+    double* __restrict x = bodies.x().data();
+    double* __restrict y = bodies.y().data();
+    if (!isolated) {
+        for (uint64_t i = begin_idx; i < end_idx; i++) {
+            wrap(x[i], y[i]);
+        }
+        return;
+    }
+    Box bounds = Box::empty();
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        bounds.add(x[i], y[i]);
+    }
+    thread_data[thread_idx].bounds = bounds;
+}
+
+void Mesh::refit() {
+    if (!isolated)
+        return;
+    Box box = Box::empty();
+    for (const ThreadData& data : thread_data) {
+        box.add(data.bounds);
+    }
+    if (!fits(box))
+        fit(box);
+}
+
+// The isolated mesh keeps the bodies `PM_ISOLATED_MARGIN_CELLS` cells away from its edges, so no
+// stencil reaches the padding
+void Mesh::fit(const Box& box) {
+    using namespace Constants::Simulation;
+    const double extent = std::max({box.max_x - box.min_x, box.max_y - box.min_y,
+            std::numeric_limits<double>::min()});
+    const uint32_t usable_cells = isolated ? grid_n - 2 * PM_ISOLATED_MARGIN_CELLS : grid_n;
+    cell = extent * PM_BOX_SLACK / usable_cells;
+    origin_x = 0.5 * (box.min_x + box.max_x) - 0.5 * grid_n * cell;
+    origin_y = 0.5 * (box.min_y + box.max_y) - 0.5 * grid_n * cell;
+    fits_done++;
+    compute_green();
+}
+
+bool Mesh::fits(const Box& box) const {
+    using namespace Constants::Simulation;
+    const double low = PM_ISOLATED_MARGIN_CELLS * cell;
+    const double high = (grid_n - PM_ISOLATED_MARGIN_CELLS) * cell;
+    const double extent = std::max(box.max_x - box.min_x, box.max_y - box.min_y);
+    const uint32_t usable_cells = grid_n - 2 * PM_ISOLATED_MARGIN_CELLS;
+    return box.min_x >= origin_x + low && box.min_y >= origin_y + low
+           && box.max_x < origin_x + high && box.max_y < origin_y + high
+           && 2.0 * extent * PM_BOX_SLACK / usable_cells >= cell;
+}
+
+// Interpolates with the deposit weights, so that a body exerts no force on itself
+sf::Vector2<double> Mesh::acceleration(double x, double y) const {
+    const Stencil sx = stencil((x - origin_x) / cell, tsc);
+    const Stencil sy = stencil((y - origin_y) / cell, tsc);
+    sf::Vector2<double> acc = {0.0, 0.0};
+    for (uint32_t b = 0; b < sy.width; b++) {
+        const uint64_t row = static_cast<uint64_t>((sy.first + b) & (grid_n - 1)) * grid_n;
+        for (uint32_t a = 0; a < sx.width; a++) {
+            const uint64_t cell_idx = row + ((sx.first + a) & (grid_n - 1));
+            const double w = sy.w[b] * sx.w[a];
+            acc.x += grid_ax[cell_idx] * w;
+            acc.y += grid_ay[cell_idx] * w;
+        }
+    }
+    return acc;
+}
+
+void Mesh::wrap(double& x, double& y) const {
+    const double side = box_side();
+    x -= side * std::floor((x - origin_x) / side);
+    y -= side * std::floor((y - origin_y) / side);
+}
+
+bool Mesh::is_periodic() const {
+    return !isolated;
+}
+
+uint32_t Mesh::size() const {
+    return grid_n;
+}
+
+double Mesh::cell_size() const {
+    return cell;
+}
+
+double Mesh::box_side() const {
+    return grid_n * cell;
+}
+
+double Mesh::split_scale() const {
+    return split_cells * cell;
+}
+
+uint64_t Mesh::fit_count() const {
+    return fits_done;
+}
+
+std::pair<uint64_t, uint64_t> Mesh::thread_range(uint64_t n, uint16_t thread_idx) const {
+    return {n * thread_idx / n_threads, n * (thread_idx + 1) / n_threads};
+}
+
+// Fills `green` with the spectrum of the Green's function, transposed (kx major) so that the
+// column pass reads it contiguously, and scaled such that the inverse FFT yields the potential.
+// Periodic: the potential of a mass distribution with Fourier coefficients rho_k over a box of
+// side L is sum(G_k rho_k exp(i k x)) / L^2, with the k = 0 term (the mean density) dropped.
+// Isolated: the real space kernel over the padded grid, with wrapped distances, transformed here.
+// The full kernel of a cell on itself is softened by half a cell, its mass is not a point.
+// Split: the softened kernel is 1 / R, R = sqrt(r^2 + eps^2), the 3D potential at a height of eps
+// above the plane, and its long range part is erf(R / 2 r_s) / R. The spectrum of the latter
+// in the plane is pi / k (exp(k eps) erfc(k r_s + eps / 2 r_s) + exp(-k eps) erfc(k r_s - eps /
+// 2 r_s)), and its value at R = 0 is 1 / (sqrt(pi) r_s).
+void Mesh::compute_green() {
+    const double eps = std::sqrt(epsilon_squared);
+    const double r_s = split_scale();
+    if (!isolated) {
+        const double side = box_side();
+        const double k_unit = 2.0 * M_PI / side;
+        for (uint32_t i = 0; i < grid_n; i++) {
+            const double fx = i <= grid_n / 2 ? i : static_cast<double>(i) - grid_n;
+            for (uint32_t j = 0; j < grid_n; j++) {
+                const double fy = j <= grid_n / 2 ? j : static_cast<double>(j) - grid_n;
+                const double k = k_unit * std::sqrt(fx * fx + fy * fy);
+                double shape = std::exp(-k * eps);
+                if (r_s > 0.0) {
+                    // erfc underflows to 0 long before exp(k eps) overflows
+                    const double upper = std::erfc(k * r_s + 0.5 * eps / r_s);
+                    shape = 0.5 * (upper == 0.0 ? 0.0 : std::exp(k * eps) * upper)
+                            + 0.5 * std::exp(-k * eps) * std::erfc(k * r_s - 0.5 * eps / r_s);
+                }
+                green[static_cast<uint64_t>(i) * grid_n + j] =
+                        k == 0.0 ? 0.0 : -2.0 * M_PI * shape / k / (side * side);
+            }
+        }
+        if (r_s > 0.0)
+            deconvolve();
+        return;
+    }
+
+    for (uint32_t j = 0; j < padded_n; j++) {
+        const double dy = std::min(j, padded_n - j) * cell;
+        for (uint32_t i = 0; i < padded_n; i++) {
+            const double dx = std::min(i, padded_n - i) * cell;
+            const double dist_sq = dx * dx + dy * dy;
+            double potential;
+            if (r_s > 0.0) {
+                const double soft_dist = std::sqrt(dist_sq + epsilon_squared);
+                potential = soft_dist == 0.0 ? -1.0 / (std::sqrt(M_PI) * r_s)
+                                             : -std::erf(0.5 * soft_dist / r_s) / soft_dist;
+            }
+            else {
+                potential = -1.0 / std::sqrt((dist_sq == 0.0 ? 0.25 * cell * cell : dist_sq)
+                                             + epsilon_squared);
+            }
+            grid[static_cast<uint64_t>(j) * padded_n + i] = potential;
+        }
+        plan.forward(grid.data() + static_cast<uint64_t>(j) * padded_n);
+    }
+    // The kernel is even, its spectrum is real
+    std::complex<double>* column = thread_data[0].columns.data();
+    const double scale = 1.0 / (static_cast<double>(padded_n) * padded_n);
+    for (uint32_t i = 0; i < padded_n; i++) {
+        for (uint32_t j = 0; j < padded_n; j++) {
+            column[j] = grid[static_cast<uint64_t>(j) * padded_n + i];
+        }
+        plan.forward(column);
+        for (uint32_t j = 0; j < padded_n; j++) {
+            green[static_cast<uint64_t>(i) * padded_n + j] = column[j].real() * scale;
+        }
+    }
+    if (r_s > 0.0)
+        deconvolve();
+}
+
+// Divides the split spectrum by the squared window of the assignment, sinc^2 (CIC) or sinc^3 (TSC)
+// per axis, which the deposit and the interpolation each apply once. The split kernel is smooth
+// enough for its high frequencies to stay small, the full kernel is left as is.
+void Mesh::deconvolve() {
+    const uint32_t power = tsc ? 6 : 4;
+    std::vector<double> window(padded_n);
+    for (uint32_t i = 0; i < padded_n; i++) {
+        const double f = i <= padded_n / 2 ? i : static_cast<double>(i) - padded_n;
+        const double arg = M_PI * f / padded_n;
+        window[i] = std::pow(arg == 0.0 ? 1.0 : std::sin(arg) / arg, power);
+    }
+    for (uint32_t i = 0; i < padded_n; i++) {
+        for (uint32_t j = 0; j < padded_n; j++) {
+            green[static_cast<uint64_t>(i) * padded_n + j] /= window[i] * window[j];
+        }
+    }
+}
+
+uint32_t Mesh::strip_of(double y) const {
+    const int32_t row = static_cast<int32_t>(std::floor((y - origin_y) / cell));
+    return static_cast<uint64_t>(row & (grid_n - 1)) * n_strips / grid_n;
+}
+
+// The deposit is a counting sort of the bodies by row strip. Every stencil reaches one row past
+// the strip of its body and strips are at least two rows high, so strips of the same parity
+// never write to the same row and can be deposited concurrently.
+void Mesh::count_strips(const Bodies& bodies, uint16_t thread_idx) {
+    ThreadData& data = thread_data[thread_idx];
+    std::fill(data.strip_counts.begin(), data.strip_counts.end(), 0);
+    const auto [begin_idx, end_idx] = thread_range(bodies.n, thread_idx);
+    const double* y = bodies.y().data();
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        data.strip_counts[strip_of(y[i])]++;
+    }
+}
+
+// Each thread scatters its bodies behind those of the same strip from lower threads, after all
+// the bodies of lower strips
+void Mesh::scatter_strips(const Bodies& bodies, uint16_t thread_idx) {
+    ThreadData& data = thread_data[thread_idx];
+    std::vector<uint64_t> offsets(n_strips);
+    uint64_t strip_begin = 0;
+    for (uint32_t s = 0; s < n_strips; s++) {
+        data.strip_begin[s] = strip_begin;
+        offsets[s] = strip_begin;
+        for (uint16_t t = 0; t < n_threads; t++) {
+            if (t < thread_idx)
+                offsets[s] += thread_data[t].strip_counts[s];
+            strip_begin += thread_data[t].strip_counts[s];
+        }
+    }
+    data.strip_begin[n_strips] = strip_begin;
+    const auto [begin_idx, end_idx] = thread_range(bodies.n, thread_idx);
+    const double* y = bodies.y().data();
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        strip_bodies[offsets[strip_of(y[i])]++] = i;
+    }
+}
+
+void Mesh::deposit_strips(const Bodies& bodies, uint16_t thread_idx, uint32_t parity) {
+    const ThreadData& data = thread_data[thread_idx];
+    const double* x = bodies.x().data();
+    const double* y = bodies.y().data();
+    const double inv_cell = 1.0 / cell;
+    for (uint32_t s = 2 * thread_idx + parity; s < n_strips; s += 2 * n_threads) {
+        for (uint64_t k = data.strip_begin[s]; k < data.strip_begin[s + 1]; k++) {
+            const uint64_t i = strip_bodies[k];
+            const Stencil sx = stencil((x[i] - origin_x) * inv_cell, tsc);
+            const Stencil sy = stencil((y[i] - origin_y) * inv_cell, tsc);
+            const double mass = bodies.mass(i);
+            for (uint32_t b = 0; b < sy.width; b++) {
+                double* row = density.data()
+                              + static_cast<uint64_t>((sy.first + b) & (grid_n - 1)) * grid_n;
+                const double row_mass = mass * sy.w[b];
+                for (uint32_t a = 0; a < sx.width; a++) {
+                    row[(sx.first + a) & (grid_n - 1)] += row_mass * sx.w[a];
+                }
+            }
+        }
+    }
+}
+
+// Copies the deposited rows into the zero padded work grid, clearing them for the next step
+void Mesh::forward_rows(uint16_t thread_idx) {
+    const auto [begin_row, end_row] = thread_range(grid_n, thread_idx);
+    for (uint64_t j = begin_row; j < end_row; j++) {
+        double* src = density.data() + j * grid_n;
+        std::complex<double>* dst = grid.data() + j * padded_n;
+        for (uint32_t i = 0; i < grid_n; i++) {
+            dst[i] = src[i];
+        }
+        std::fill(dst + grid_n, dst + padded_n, 0.0);
+        std::fill(src, src + grid_n, 0.0);
+        plan.forward(dst);
+    }
+}
+
+// Forward column FFTs, the product with the Green's function and the inverse column FFTs, one
+// block of columns at a time. The padding rows are zero on the way in and not needed on the way
+// out, so they never touch the grid.
+void Mesh::convolve_columns(uint16_t thread_idx) {
+    const auto [begin_block, end_block] = thread_range(padded_n / COLUMN_BLOCK, thread_idx);
+    std::complex<double>* columns = thread_data[thread_idx].columns.data();
+    for (uint64_t block = begin_block; block < end_block; block++) {
+        const uint64_t first_col = block * COLUMN_BLOCK;
+        for (uint32_t j = 0; j < grid_n; j++) {
+            const std::complex<double>* row = grid.data() + j * padded_n + first_col;
+            for (uint32_t c = 0; c < COLUMN_BLOCK; c++) {
+                columns[c * padded_n + j] = row[c];
+            }
+        }
+        for (uint32_t c = 0; c < COLUMN_BLOCK; c++) {
+            std::complex<double>* column = columns + c * padded_n;
+            const double* green_column = green.data() + (first_col + c) * padded_n;
+            std::fill(column + grid_n, column + padded_n, 0.0);
+            plan.forward(column);
+            for (uint32_t j = 0; j < padded_n; j++) {
+                column[j] *= green_column[j];
+            }
+            plan.inverse(column);
+        }
+        for (uint32_t j = 0; j < grid_n; j++) {
+            std::complex<double>* row = grid.data() + j * padded_n + first_col;
+            for (uint32_t c = 0; c < COLUMN_BLOCK; c++) {
+                row[c] = columns[c * padded_n + j];
+            }
+        }
+    }
+}
+
+void Mesh::inverse_rows(uint16_t thread_idx) {
+    const auto [begin_row, end_row] = thread_range(grid_n, thread_idx);
+    for (uint64_t j = begin_row; j < end_row; j++) {
+        plan.inverse(grid.data() + j * padded_n);
+    }
+}
+
+// Fourth order central differences of the potential, a = -grad(phi). The isolated mesh keeps the
+// bodies far enough from its edges that the wrapped differences there are never interpolated.
+void Mesh::differentiate(uint16_t thread_idx) {
+    const auto [begin_row, end_row] = thread_range(grid_n, thread_idx);
+    const uint32_t mask = grid_n - 1;
+    const double scale = -1.0 / (12.0 * cell);
+    const auto phi = [this](uint32_t i, uint32_t j) {
+        return grid[static_cast<uint64_t>(j) * padded_n + i].real();
+    };
+    for (uint32_t j = begin_row; j < end_row; j++) {
+        for (uint32_t i = 0; i < grid_n; i++) {
+            const uint64_t cell_idx = static_cast<uint64_t>(j) * grid_n + i;
+            grid_ax[cell_idx] = scale
+                                * (8.0 * (phi((i + 1) & mask, j) - phi((i - 1) & mask, j))
+                                        - (phi((i + 2) & mask, j) - phi((i - 2) & mask, j)));
+            grid_ay[cell_idx] = scale
+                                * (8.0 * (phi(i, (j + 1) & mask) - phi(i, (j - 1) & mask))
+                                        - (phi(i, (j + 2) & mask) - phi(i, (j - 2) & mask)));
+        }
+    }
+}
@@ -0,0 +1,151 @@
+// Compares the accuracy and cost of monopole and quadrupole ForceTree walks over a range of theta.
+// Errors are relative to a direct sum over a sample of the bodies.
+// Usage: n-body-2d-multipole-bench [n_bodies] [samples]
+
+#include <algorithm>
+#include <cmath>
+#include <fmt/core.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Quadtree/ForceTree.hpp"
+#include "Quadtree/Quadtree.hpp"
+#include "StopWatch/StopWatch.hpp"
+
+
+namespace {
+
+constexpr double EPSILON_SQ = 1e-8;
+constexpr uint32_t LEAF_SIZE = 8;
+constexpr double THETAS[] = {0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 1.0};
+
+// Uneven masses in an exponential disk with a dense core, so that nodes have large moments
+Bodies make_disk(uint64_t n) {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::exponential_distribution<double> radius(4.0);
+    std::vector<std::string> ids(n);
+    std::vector<double> mass(n);
+    std::vector<sf::Vector2<double>> pos(n);
+    std::vector<sf::Vector2<double>> vel(n, {0.0, 0.0});
+    for (uint64_t i = 0; i < n; i++) {
+        const double r = radius(rng);
+        const double phi = 2.0 * M_PI * unit(rng);
+        ids[i] = std::to_string(i);
+        mass[i] = std::pow(10.0, 2.0 * unit(rng));
+        pos[i] = {r * std::cos(phi), r * std::sin(phi)};
+    }
+    return Bodies(std::move(ids), std::move(mass), std::move(pos), std::move(vel));
+}
+
+sf::Vector2<double> accel(double x, double y, double other_x, double other_y, double mass) {
+    const double dx = other_x - x;
+    const double dy = other_y - y;
+    const double dist_sq = dx * dx + dy * dy + EPSILON_SQ;
+    const double f = mass / (dist_sq * std::sqrt(dist_sq));
+    return {dx * f, dy * f};
+}
+
+struct Walk {
+    sf::Vector2<double> a = {0.0, 0.0};
+    uint32_t interactions = 0;
+};
+
+Walk walk(const ForceTree& tree, double x, double y, double theta_sq, bool quadrupole) {
+    Walk result;
+    uint32_t node_idx = 0;
+    while (node_idx != ForceTree::END) {
+        const ForceTree::Node& node = tree.nodes[node_idx];
+        if (node.is_leaf()) {
+            for (uint32_t i = node.body_begin; i < node.body_end; i++) {
+                if (tree.body_x[i] != x || tree.body_y[i] != y)
+                    result.a += accel(x, y, tree.body_x[i], tree.body_y[i], tree.body_mass[i]);
+            }
+            result.interactions += node.body_end - node.body_begin;
+            node_idx = node.next;
+            continue;
+        }
+        const double rx = x - node.com_x;
+        const double ry = y - node.com_y;
+        if (node.width_sq < theta_sq * (rx * rx + ry * ry)) {
+            result.a += accel(x, y, node.com_x, node.com_y, node.mass);
+            if (quadrupole)
+                result.a += tree.quadrupoles[node_idx].acceleration(rx, ry, EPSILON_SQ);
+            result.interactions++;
+            node_idx = node.next;
+        }
+        else {
+            node_idx = node.first_child;
+        }
+    }
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const uint64_t n_bodies = argc > 1 ? std::stoull(argv[1]) : 50'000;
+    const uint32_t n_samples = argc > 2 ? std::stoul(argv[2]) : 1'000;
+
+    const Bodies bodies = make_disk(n_bodies);
+    Quadtree qtree(Quadtree::BuildMode::PARTITION, LEAF_SIZE);
+    qtree.build_tree(bodies);
+    ForceTree tree;
+    tree.pack(qtree);
+    StopWatch sw_moments;
+    tree.compute_quadrupoles();
+    sw_moments.pause();
+
+    // Direct sum reference for every `stride`th body in tree order
+    const uint32_t stride = std::max<uint64_t>(n_bodies / n_samples, 1);
+    std::vector<uint32_t> samples;
+    std::vector<sf::Vector2<double>> reference;
+    for (uint32_t i = 0; i < n_bodies; i += stride) {
+        sf::Vector2<double> a = {0.0, 0.0};
+        for (uint32_t j = 0; j < n_bodies; j++) {
+            if (j != i)
+                a += accel(tree.body_x[i], tree.body_y[i], tree.body_x[j], tree.body_y[j],
+                        tree.body_mass[j]);
+        }
+        samples.push_back(i);
+        reference.push_back(a);
+    }
+
+    fmt::println("{} bodies, leaf size {}, {} nodes, quadrupoles computed in [{}], {} samples",
+            n_bodies, LEAF_SIZE, tree.nodes.size(), sw_moments, samples.size());
+    fmt::println("{:>5} {:<10} {:>14} {:>10} {:>12} {:>12} {:>14}", "theta", "expansion",
+            "interactions", "walk", "rms error", "max error", "checksum");
+    for (const double theta : THETAS) {
+        for (const bool quadrupole : {false, true}) {
+            const double theta_sq = theta * theta;
+            uint64_t interactions = 0;
+            double checksum = 0.0;
+            StopWatch sw;
+            for (uint32_t i = 0; i < n_bodies; i++) {
+                const Walk result = walk(tree, tree.body_x[i], tree.body_y[i], theta_sq,
+                        quadrupole);
+                interactions += result.interactions;
+                checksum += result.a.x;
+            }
+            sw.pause();
+
+            double err_sq_sum = 0.0;
+            double err_max = 0.0;
+            for (uint32_t s = 0; s < samples.size(); s++) {
+                const uint32_t i = samples[s];
+                const Walk result = walk(tree, tree.body_x[i], tree.body_y[i], theta_sq,
+                        quadrupole);
+                const double err = (result.a - reference[s]).length() / reference[s].length();
+                err_sq_sum += err * err;
+                err_max = std::max(err_max, err);
+            }
+            fmt::println("{:>5.2f} {:<10} {:>14.1f} {:>9.3f}s {:>12.3e} {:>12.3e} {:>14.6e}",
+                    theta, quadrupole ? "quadrupole" : "monopole",
+                    static_cast<double>(interactions) / n_bodies,
+                    sw.elapsed<std::chrono::seconds, 6>(), std::sqrt(err_sq_sum / samples.size()),
+                    err_max, checksum);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+// Compares the force walk over the build-time `Quad` array with the stack-based and stackless
+// walks over the packed ForceTree, all on the same tree.
+// Usage: n-body-2d-traversal-bench [n_bodies] [theta] [reps]
+
+#include <cmath>
+#include <fmt/core.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Quadtree/ForceTree.hpp"
+#include "Quadtree/Quadtree.hpp"
+#include "StopWatch/StopWatch.hpp"
+
+
+namespace {
+
+constexpr double EPSILON_SQ = 1e-6;
+
+struct WalkResult {
+    uint64_t nodes_visited = 0;
+    double checksum = 0.0;
+};
+
+Bodies make_disk(uint64_t n) {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<std::string> ids(n);
+    std::vector<double> mass(n);
+    std::vector<sf::Vector2<double>> pos(n);
+    std::vector<sf::Vector2<double>> vel(n, {0.0, 0.0});
+    for (uint64_t i = 0; i < n; i++) {
+        const double r = std::sqrt(unit(rng));
+        const double phi = 2.0 * M_PI * unit(rng);
+        ids[i] = std::to_string(i);
+        mass[i] = 1.0 + unit(rng);
+        pos[i] = {r * std::cos(phi), r * std::sin(phi)};
+    }
+    return Bodies(std::move(ids), std::move(mass), std::move(pos), std::move(vel));
+}
+
+sf::Vector2<double> accel(const sf::Vector2<double>& pos, const sf::Vector2<double>& other,
+        double mass) {
+    const sf::Vector2<double> d = other - pos;
+    const double dist_sq = d.lengthSquared() + EPSILON_SQ;
+    return d * (mass / (dist_sq * std::sqrt(dist_sq)));
+}
+
+// The walk BarnesHut::update_velocity performed before the ForceTree was introduced
+WalkResult walk_quads(const Quadtree& qtree, const Bodies& bodies, double theta_sq) {
+    WalkResult result;
+    std::vector<uint32_t> stack;
+    for (uint64_t body_idx = 0; body_idx < bodies.n; body_idx++) {
+        const sf::Vector2<double> pos = bodies.pos(body_idx);
+        sf::Vector2<double> a = {0.0, 0.0};
+        stack.push_back(0);
+        while (!stack.empty()) {
+            const Quad& quad = qtree.quads[stack.back()];
+            stack.pop_back();
+            result.nodes_visited++;
+            if (quad.is_leaf()) {
+                if (quad.total_mass != 0 && quad.center_of_mass != pos)
+                    a += accel(pos, quad.center_of_mass, quad.total_mass);
+            }
+            else if (quad.boundaries.size.lengthSquared()
+                             / (pos - quad.center_of_mass).lengthSquared()
+                     < theta_sq) {
+                a += accel(pos, quad.center_of_mass, quad.total_mass);
+            }
+            else {
+                stack.push_back(quad.top_left_idx + 3);
+                stack.push_back(quad.top_left_idx + 2);
+                stack.push_back(quad.top_left_idx + 1);
+                stack.push_back(quad.top_left_idx);
+            }
+        }
+        result.checksum += a.x + a.y;
+    }
+    return result;
+}
+
+void leaf_accel(const ForceTree& tree, const Bodies& bodies, const ForceTree::Node& node,
+        sf::Vector2<double> pos, sf::Vector2<double>& a) {
+    if (node.body_end - node.body_begin == 1) {
+        const sf::Vector2<double> com = {node.com_x, node.com_y};
+        if (com != pos)
+            a += accel(pos, com, node.mass);
+        return;
+    }
+    for (uint32_t i = node.body_begin; i < node.body_end; i++) {
+        const uint32_t other_idx = tree.body_idxs[i];
+        if (bodies.pos(other_idx) != pos)
+            a += accel(pos, bodies.pos(other_idx), bodies.mass(other_idx));
+    }
+}
+
+// Explicit stack of child indices; a node's children are found through the sibling chain
+WalkResult walk_force_tree_stack(const ForceTree& tree, const Bodies& bodies, double theta_sq) {
+    WalkResult result;
+    std::vector<uint32_t> stack;
+    for (uint64_t body_idx = 0; body_idx < bodies.n; body_idx++) {
+        const sf::Vector2<double> pos = bodies.pos(body_idx);
+        sf::Vector2<double> a = {0.0, 0.0};
+        stack.push_back(0);
+        while (!stack.empty()) {
+            const ForceTree::Node& node = tree.nodes[stack.back()];
+            stack.pop_back();
+            result.nodes_visited++;
+            const sf::Vector2<double> com = {node.com_x, node.com_y};
+            if (node.is_leaf()) {
+                leaf_accel(tree, bodies, node, pos, a);
+            }
+            else if (node.width_sq / (pos - com).lengthSquared() < theta_sq) {
+                a += accel(pos, com, node.mass);
+            }
+            else {
+                for (uint32_t child_idx = node.first_child; child_idx != node.next;
+                        child_idx = tree.nodes[child_idx].next) {
+                    stack.push_back(child_idx);
+                }
+            }
+        }
+        result.checksum += a.x + a.y;
+    }
+    return result;
+}
+
+// Stackless walk over the first_child/next threading
+WalkResult walk_force_tree(const ForceTree& tree, const Bodies& bodies, double theta_sq) {
+    WalkResult result;
+    for (uint64_t body_idx = 0; body_idx < bodies.n; body_idx++) {
+        const sf::Vector2<double> pos = bodies.pos(body_idx);
+        sf::Vector2<double> a = {0.0, 0.0};
+        uint32_t node_idx = 0;
+        while (node_idx != ForceTree::END) {
+            const ForceTree::Node& node = tree.nodes[node_idx];
+            result.nodes_visited++;
+            const sf::Vector2<double> com = {node.com_x, node.com_y};
+            if (node.is_leaf()) {
+                leaf_accel(tree, bodies, node, pos, a);
+                node_idx = node.next;
+            }
+            else if (node.width_sq / (pos - com).lengthSquared() < theta_sq) {
+                a += accel(pos, com, node.mass);
+                node_idx = node.next;
+            }
+            else {
+                node_idx = node.first_child;
+            }
+        }
+        result.checksum += a.x + a.y;
+    }
+    return result;
+}
+
+template <typename Walk>
+void run(const char* name, uint32_t reps, Walk&& walk) {
+    WalkResult total;
+    StopWatch sw;
+    for (uint32_t rep = 0; rep < reps; rep++) {
+        const WalkResult result = walk();
+        total.nodes_visited += result.nodes_visited;
+        total.checksum += result.checksum;
+    }
+    sw.pause();
+    const double seconds = sw.elapsed<std::chrono::seconds, 6>();
+    fmt::println("{:<10} {:>12} nodes/walk {:>8.2f} M nodes/s  [{}]  checksum {:.6e}", name,
+            total.nodes_visited / reps, total.nodes_visited / seconds * 1e-6, sw, total.checksum);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const uint64_t n_bodies = argc > 1 ? std::stoull(argv[1]) : 100'000;
+    const double theta = argc > 2 ? std::stod(argv[2]) : 0.5;
+    const uint32_t reps = argc > 3 ? std::stoul(argv[3]) : 5;
+    const double theta_sq = theta * theta;
+
+    const Bodies bodies = make_disk(n_bodies);
+    Quadtree qtree(Quadtree::BuildMode::PARTITION);
+    qtree.build_tree(bodies);
+    ForceTree force_tree;
+    force_tree.pack(qtree);
+
+    fmt::println("{} bodies, theta {}, {} quads, {} packed nodes ({} B each)", n_bodies, theta,
+            qtree.quads.size(), force_tree.nodes.size(), sizeof(ForceTree::Node));
+    run("Quad", reps, [&] { return walk_quads(qtree, bodies, theta_sq); });
+    run("Stack", reps, [&] { return walk_force_tree_stack(force_tree, bodies, theta_sq); });
+    run("Stackless", reps, [&] { return walk_force_tree(force_tree, bodies, theta_sq); });
+    return 0;
+}
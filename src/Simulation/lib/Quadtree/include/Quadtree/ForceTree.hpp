@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Quadtree/Quadtree.hpp"
+
+
+// Traversal-only copy of a quadtree, the CPU counterpart of the CUDA ForceNode array.
+// Only non-empty nodes are stored. The children of a node are contiguous, and these sibling
+// blocks are laid out in depth-first order, so a subtree occupies a compact range of the array.
+// The tree is threaded: `next` skips a node's subtree, so a walk needs no stack, it continues at
+// `first_child` to open a node and at `next` otherwise, until it reaches END.
+class ForceTree {
+public:
+    static constexpr uint32_t END = std::numeric_limits<uint32_t>::max();
+
+    struct Node {
+        double com_x;
+        double com_y;
+        double mass;
+        double width_sq;
+        uint32_t first_child;  // 0 for leaves, the last child's `next` is the node's `next`
+        uint32_t next;         // next node in depth-first order after the subtree, or END
+        uint32_t body_begin;   // bodies of the subtree: [body_begin, body_end) into `body_idxs`
+        uint32_t body_end;
+
+        bool is_leaf() const;
+    };
+    static_assert(sizeof(Node) == 48);
+
+    // In-plane components of the traceless quadrupole tensor sum(m * (3 d d^T - |d|^2 I)) of a
+    // node, with d the offset of a body from the node's COM. The dipole vanishes about the COM,
+    // so monopole + quadrupole is the expansion up to second order.
+    struct Quadrupole {
+        double xx;
+        double xy;
+        double yy;
+
+        // Quadrupole term of the Plummer softened acceleration (without G) at offset (rx, ry)
+        // from the node's COM, to be added to the monopole term
+        sf::Vector2<double> acceleration(double rx, double ry, double epsilon_sq) const;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> body_idxs;
+    // Leaf body data (SoA) in `body_idxs` order, so a leaf's bodies are contiguous slices
+    std::vector<double> body_x;
+    std::vector<double> body_y;
+    std::vector<double> body_mass;
+    // Indexed like `nodes`, only filled by `compute_quadrupoles`
+    std::vector<Quadrupole> quadrupoles;
+
+    void pack(const Quadtree& qtree);
+    // Re-reads the positions of the packed bodies and recomputes the COMs bottom-up, keeping the
+    // topology. A node's width grows to the farthest reach of its bodies from the new COM, so the
+    // opening criterion stays conservative for bodies that drifted out of their cell.
+    void refresh(const Bodies& bodies);
+    // Bottom-up over the packed nodes, so it serves every tree builder
+    void compute_quadrupoles();
+    // Fills `groups` with the largest nodes holding at most `max_bodies` bodies (and with leaves
+    // holding more), in depth-first order. Their body ranges partition `body_idxs` in order.
+    void collect_groups(uint32_t max_bodies, std::vector<uint32_t>& groups) const;
+    // Calls `visit(k)` for every slot k of `body_idxs` in the leaves that may hold bodies within
+    // `radius` of (x, y), the caller checks the distances. A subtree is skipped when its COM is
+    // farther than the radius plus its diagonal, which bounds the distance of its bodies from it.
+    template <typename F>
+    void visit_bodies_near(double x, double y, double radius, F&& visit) const;
+
+private:
+    std::vector<double> reach;  // refresh: farthest body of every node from its COM
+
+    void pack_recursive(const Quadtree& qtree, uint32_t quad_idx, uint32_t node_idx,
+            uint32_t next);
+    void collect_groups_recursive(uint32_t node_idx, uint32_t max_bodies,
+            std::vector<uint32_t>& groups) const;
+};
+
+template <typename F>
+void ForceTree::visit_bodies_near(double x, double y, double radius, F&& visit) const {
+    uint32_t node_idx = nodes.empty() ? END : 0;
+    while (node_idx != END) {
+        const Node& node = nodes[node_idx];
+        const double dx = node.com_x - x;
+        const double dy = node.com_y - y;
+        const double reach = radius + std::sqrt(node.width_sq);
+        if (dx * dx + dy * dy > reach * reach) {
+            node_idx = node.next;
+            continue;
+        }
+        if (!node.is_leaf()) {
+            node_idx = node.first_child;
+            continue;
+        }
+        for (uint32_t k = node.body_begin; k < node.body_end; k++) {
+            visit(k);
+        }
+        node_idx = node.next;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <barrier>
+#include <cstdint>
+#include <vector>
+
+#include "Body/Body.hpp"
+#include "Quadtree/ForceTree.hpp"
+
+
+// CPU port of the Morton/radix-sort/topology pipeline of BarnesHutCuda.
+// Every phase is split across `n_threads` threads, all of which must call build_tree() with
+// their own `thread_idx` and the same barrier. The tree is complete once build_tree() returns,
+// pack() then copies it into a ForceTree, also across all threads.
+class MortonQuadtree {
+public:
+    // Node arrays (SoA), indexed by node id. Nodes of the same level are contiguous and so are
+    // the children of a node: [first_child, first_child + child_count).
+    std::vector<double> mass;
+    std::vector<double> com_x;
+    std::vector<double> com_y;
+    std::vector<double> width_sq;
+    std::vector<uint32_t> first_child;
+    std::vector<uint32_t> child_count;
+    std::vector<uint32_t> body_begin;  // [body_begin, body_end) into the Morton ordered arrays
+    std::vector<uint32_t> body_end;
+    std::vector<uint32_t> subtree_size;  // node count of the subtree, including the node
+
+    // Body arrays in Morton order
+    std::vector<uint32_t> sorted_idxs;
+    std::vector<double> sorted_x;
+    std::vector<double> sorted_y;
+    std::vector<double> sorted_mass;
+
+    MortonQuadtree(uint64_t n_bodies, uint16_t n_threads, uint32_t leaf_size = 1);
+    void build_tree(const Bodies& bodies, uint16_t thread_idx, std::barrier<>& sync_point);
+    void pack(ForceTree& force_tree, uint16_t thread_idx, std::barrier<>& sync_point);
+    bool is_leaf(uint32_t node_idx) const;
+    // Follows merged bodies, the arrays keep their capacity
+    void set_body_count(uint64_t n_bodies);
+
+private:
+    static constexpr uint32_t RADIX_BITS = 8;
+    static constexpr uint32_t RADIX = 1 << RADIX_BITS;
+
+    struct Box {
+        double x_min, x_max, y_min, y_max;
+    };
+
+    uint64_t n_bodies;
+    const uint16_t n_threads;
+    const uint32_t leaf_size;  // max bodies in a leaf node before splitting
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> keys_alt;
+    std::vector<uint32_t> idxs;
+    std::vector<uint32_t> idxs_alt;
+    std::vector<Box> thread_boxes;
+    std::vector<std::array<uint32_t, RADIX>> thread_histograms;
+    std::vector<uint32_t> thread_node_counts;
+    std::vector<uint32_t> level_begin;
+    std::vector<uint32_t> packed_idx;
+    std::vector<uint32_t> packed_children_idx;
+    std::vector<uint32_t> packed_next;
+
+    std::pair<uint64_t, uint64_t> thread_chunk(uint64_t begin, uint64_t end,
+            uint16_t thread_idx) const;
+    Box compute_bounding_box(const Bodies& bodies, uint16_t thread_idx,
+            std::barrier<>& sync_point);
+    void compute_morton_codes(const Bodies& bodies, const Box& box, uint16_t thread_idx);
+    const uint64_t* sort_by_morton(const Bodies& bodies, uint16_t thread_idx,
+            std::barrier<>& sync_point);
+    void build_tree_topology(const uint64_t* sorted_keys, uint16_t thread_idx,
+            std::barrier<>& sync_point);
+    void propagate_com_up(uint16_t thread_idx, std::barrier<>& sync_point);
+    void grow_nodes(uint64_t min_size);
+};
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <forward_list>
+#include <span>
 #include <vector>
 
 #include "SFML/Graphics/Rect.hpp"
@@ -14,6 +15,8 @@ public:
     uint32_t body_count = 0;
     const sf::Rect<double> boundaries;
     std::forward_list<uint64_t> body_idxs;
+    uint32_t body_begin = 0;  // BuildMode::PARTITION: [body_begin, body_end) into body_idx_array
+    uint32_t body_end = 0;
     sf::Vector2<double> momentum;
     sf::Vector2<double> center_of_mass;
     double total_mass = 0;
@@ -24,13 +27,49 @@ public:
 
 class Quadtree {
 public:
+    // LINKED_LIST: every quad splices its bodies into per-child forward lists.
+    // PARTITION: a single body index array is partitioned in place into child ranges, so
+    // building the tree performs no allocations once `quads` has reached its steady-state size.
+    enum class BuildMode : uint8_t { LINKED_LIST, PARTITION };
+
+    struct RefitStats {
+        uint64_t refits = 0;
+        uint64_t rebuilds = 0;
+        uint64_t migrated_bodies = 0;
+    };
+
     const Bodies* bodies;
 
-    Quadtree();
+    // Quads holding up to `leaf_size` bodies are not split further
+    Quadtree(BuildMode build_mode = BuildMode::LINKED_LIST, uint32_t leaf_size = 1);
     ~Quadtree();
+    BuildMode get_build_mode() const;
     void build_tree(const Bodies& bodies);
+    // BuildMode::PARTITION only: keeps the quads of the last tree, moves the bodies that left their
+    // leaf and recomputes the quads bottom-up. The tree is rebuilt instead (with a padded root)
+    // when it has degraded too much, or when there is no tree of the current bodies to refit.
+    void refit_tree(const Bodies& bodies);
+    // Follows a `Bodies::reorder(order)` so that the kept body order stays valid
+    void reorder_bodies(std::span<const uint32_t> order);
+    const RefitStats& get_refit_stats() const;
     std::vector<Quad> quads;
+    std::vector<uint32_t> body_idx_array;
 
 private:
+    const BuildMode build_mode;
+    const uint32_t leaf_size;
+    RefitStats refit_stats;
+    uint32_t refits_since_build = 0;
+    std::vector<uint32_t> leaf_targets;  // refit: destination leaf of every body_idx_array entry
+    std::vector<uint32_t> leaf_cursors;
+    std::vector<uint32_t> refit_body_idxs;
+
+    void build(const Bodies& bodies, double root_margin);
+    bool try_refit();
+    uint32_t find_leaf(const sf::Vector2<double>& pos) const;
+    uint32_t assign_ranges(uint32_t quad_idx, uint32_t begin);
+    void update_leaf(uint32_t quad_idx);
     void fill_tree_recursive(uint32_t quad_idx);
+    void partition_tree_recursive(uint32_t quad_idx, uint32_t depth);
+    void aggregate_children(uint32_t quad_idx);
 };
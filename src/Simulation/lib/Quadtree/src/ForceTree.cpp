@@ -0,0 +1,202 @@
+#include "Quadtree/ForceTree.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+bool ForceTree::Node::is_leaf() const {
+    return first_child == 0;
+}
+
+sf::Vector2<double> ForceTree::Quadrupole::acceleration(double rx, double ry,
+        double epsilon_sq) const {
+    const double r_sq = rx * rx + ry * ry + epsilon_sq;
+    const double inv_r_sq = 1.0 / r_sq;
+    const double inv_r5 = inv_r_sq * inv_r_sq / std::sqrt(r_sq);
+    const double qr_x = xx * rx + xy * ry;
+    const double qr_y = xy * rx + yy * ry;
+    const double rqr = 2.5 * (rx * qr_x + ry * qr_y) * inv_r_sq;
+    return {(qr_x - rqr * rx) * inv_r5, (qr_y - rqr * ry) * inv_r5};
+}
+
+void ForceTree::pack(const Quadtree& qtree) {
+    // Capacity is kept between iterations
+    nodes.clear();
+    body_idxs.clear();
+    nodes.emplace_back();
+    pack_recursive(qtree, 0, 0, END);
+
+    const Bodies& bodies = *qtree.bodies;
+    body_x.resize(body_idxs.size());
+    body_y.resize(body_idxs.size());
+    body_mass.resize(body_idxs.size());
+    const std::span<const double> x = bodies.x();
+    const std::span<const double> y = bodies.y();
+    const std::span<const double> mass = bodies.masses();
+    for (uint32_t i = 0; i < body_idxs.size(); i++) {
+        body_x[i] = x[body_idxs[i]];
+        body_y[i] = y[body_idxs[i]];
+        body_mass[i] = mass[body_idxs[i]];
+    }
+}
+
+// Fills in `node_idx`, appends the block of its non-empty children and then packs every child.
+// `next` is the node the walk continues at after this subtree.
+void ForceTree::pack_recursive(const Quadtree& qtree, uint32_t quad_idx, uint32_t node_idx,
+        uint32_t next) {
+    const Quad& quad = qtree.quads[quad_idx];
+    Node node{.com_x = quad.center_of_mass.x,
+            .com_y = quad.center_of_mass.y,
+            .mass = quad.total_mass,
+            .width_sq = quad.boundaries.size.lengthSquared(),
+            .first_child = 0,
+            .next = next,
+            .body_begin = static_cast<uint32_t>(body_idxs.size()),
+            .body_end = 0};
+
+    if (quad.is_leaf()) {
+        if (qtree.get_build_mode() == Quadtree::BuildMode::PARTITION) {
+            body_idxs.insert(body_idxs.end(), qtree.body_idx_array.begin() + quad.body_begin,
+                    qtree.body_idx_array.begin() + quad.body_end);
+        }
+        else {
+            body_idxs.insert(body_idxs.end(), quad.body_idxs.begin(), quad.body_idxs.end());
+        }
+    }
+    else {
+        node.first_child = nodes.size();
+        uint32_t child_count = 0;
+        for (uint32_t child_idx = quad.top_left_idx; child_idx < quad.top_left_idx + 4;
+                child_idx++) {
+            child_count += qtree.quads[child_idx].body_count != 0;
+        }
+        nodes.resize(nodes.size() + child_count);
+        const uint32_t last_child_node_idx = node.first_child + child_count - 1;
+        uint32_t child_node_idx = node.first_child;
+        for (uint32_t child_idx = quad.top_left_idx; child_idx < quad.top_left_idx + 4;
+                child_idx++) {
+            if (qtree.quads[child_idx].body_count == 0)
+                continue;
+            pack_recursive(qtree, child_idx, child_node_idx,
+                    child_node_idx == last_child_node_idx ? next : child_node_idx + 1);
+            child_node_idx++;
+        }
+    }
+
+    node.body_end = body_idxs.size();
+    nodes[node_idx] = node;
+}
+
+// Children are always packed after their parent, so a reverse sweep sees every child before its
+// parent. The reach of an inner node is bounded through its children's. A node without mass exerts
+// no force, it is centered on the plain mean of its bodies or children so that its reach stays
+// tight.
+void ForceTree::refresh(const Bodies& bodies) {
+    const std::span<const double> x = bodies.x();
+    const std::span<const double> y = bodies.y();
+    for (uint32_t i = 0; i < body_idxs.size(); i++) {
+        body_x[i] = x[body_idxs[i]];
+        body_y[i] = y[body_idxs[i]];
+    }
+
+    reach.resize(nodes.size());
+    for (uint32_t node_idx = nodes.size(); node_idx-- > 0;) {
+        Node& node = nodes[node_idx];
+        const bool massless = node.mass == 0.0;
+        double com_x = 0.0;
+        double com_y = 0.0;
+        uint32_t count = 0;
+        if (node.is_leaf()) {
+            for (uint32_t i = node.body_begin; i < node.body_end; i++) {
+                const double w = massless ? 1.0 : body_mass[i];
+                com_x += body_x[i] * w;
+                com_y += body_y[i] * w;
+                count++;
+            }
+        }
+        else {
+            for (uint32_t child_idx = node.first_child; child_idx != node.next;
+                    child_idx = nodes[child_idx].next) {
+                const double w = massless ? 1.0 : nodes[child_idx].mass;
+                com_x += nodes[child_idx].com_x * w;
+                com_y += nodes[child_idx].com_y * w;
+                count++;
+            }
+        }
+        const double weight = massless ? count : node.mass;
+        node.com_x = com_x / weight;
+        node.com_y = com_y / weight;
+
+        double node_reach = 0.0;
+        if (node.is_leaf()) {
+            for (uint32_t i = node.body_begin; i < node.body_end; i++) {
+                node_reach = std::max(node_reach,
+                        std::hypot(body_x[i] - node.com_x, body_y[i] - node.com_y));
+            }
+        }
+        else {
+            for (uint32_t child_idx = node.first_child; child_idx != node.next;
+                    child_idx = nodes[child_idx].next) {
+                const Node& child = nodes[child_idx];
+                node_reach = std::max(node_reach,
+                        std::hypot(child.com_x - node.com_x, child.com_y - node.com_y)
+                                + reach[child_idx]);
+            }
+        }
+        reach[node_idx] = node_reach;
+        node.width_sq = std::max(node.width_sq, node_reach * node_reach);
+    }
+}
+
+// Children are always packed after their parent, so a reverse sweep sees every child before its
+// parent. Leaves sum their bodies, inner nodes shift their children's moments to their own COM.
+void ForceTree::compute_quadrupoles() {
+    quadrupoles.resize(nodes.size());
+    for (uint32_t node_idx = nodes.size(); node_idx-- > 0;) {
+        const Node& node = nodes[node_idx];
+        Quadrupole q = {0.0, 0.0, 0.0};
+        const auto add_point = [&](double x, double y, double mass) {
+            const double dx = x - node.com_x;
+            const double dy = y - node.com_y;
+            const double d_sq = dx * dx + dy * dy;
+            q.xx += mass * (3.0 * dx * dx - d_sq);
+            q.xy += mass * 3.0 * dx * dy;
+            q.yy += mass * (3.0 * dy * dy - d_sq);
+        };
+        if (node.is_leaf()) {
+            for (uint32_t i = node.body_begin; i < node.body_end; i++) {
+                add_point(body_x[i], body_y[i], body_mass[i]);
+            }
+        }
+        else {
+            for (uint32_t child_idx = node.first_child; child_idx != node.next;
+                    child_idx = nodes[child_idx].next) {
+                const Node& child = nodes[child_idx];
+                const Quadrupole& child_q = quadrupoles[child_idx];
+                q.xx += child_q.xx;
+                q.xy += child_q.xy;
+                q.yy += child_q.yy;
+                add_point(child.com_x, child.com_y, child.mass);
+            }
+        }
+        quadrupoles[node_idx] = q;
+    }
+}
+
+void ForceTree::collect_groups(uint32_t max_bodies, std::vector<uint32_t>& groups) const {
+    groups.clear();
+    collect_groups_recursive(0, max_bodies, groups);
+}
+
+void ForceTree::collect_groups_recursive(uint32_t node_idx, uint32_t max_bodies,
+        std::vector<uint32_t>& groups) const {
+    const Node& node = nodes[node_idx];
+    if (node.is_leaf() || node.body_end - node.body_begin <= max_bodies) {
+        groups.push_back(node_idx);
+        return;
+    }
+    for (uint32_t child_idx = node.first_child; child_idx != node.next;
+            child_idx = nodes[child_idx].next) {
+        collect_groups_recursive(child_idx, max_bodies, groups);
+    }
+}
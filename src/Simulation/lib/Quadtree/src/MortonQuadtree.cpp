@@ -0,0 +1,390 @@
+#include "Quadtree/MortonQuadtree.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "Logger/Logger.hpp"
+
+
+constexpr uint32_t MAX_DEPTH = 32;  // 64-bit Morton codes hold 32 levels of quadrants
+
+// Expand a 32-bit integer into 64 bits by inserting a 0 bit after each bit.
+static uint64_t expand_bits_2d(uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+
+// 64-bit Morton code for 2D point in [0,1)^2. Uses 32 bits per axis.
+static uint64_t morton_2d(double nx, double ny) {
+    const uint32_t ix = static_cast<uint32_t>(std::clamp(nx * 4294967296.0, 0.0, 4294967295.0));
+    const uint32_t iy = static_cast<uint32_t>(std::clamp(ny * 4294967296.0, 0.0, 4294967295.0));
+    return (expand_bits_2d(ix) << 1) | expand_bits_2d(iy);
+}
+
+// First index in [lo, hi) whose 2-bit quadrant digit at `shift` is not less than `target`
+static uint32_t lower_bound_quadrant(const uint64_t* keys, uint32_t lo, uint32_t hi,
+        uint64_t target, uint32_t shift) {
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (((keys[mid] >> shift) & 3ull) < target)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+MortonQuadtree::MortonQuadtree(uint64_t n_bodies, uint16_t n_threads, uint32_t leaf_size)
+        : sorted_idxs(n_bodies), sorted_x(n_bodies), sorted_y(n_bodies), sorted_mass(n_bodies),
+          n_bodies(n_bodies), n_threads(n_threads), leaf_size(leaf_size), keys(n_bodies),
+          keys_alt(n_bodies), idxs(n_bodies), idxs_alt(n_bodies), thread_boxes(n_threads),
+          thread_histograms(n_threads), thread_node_counts(n_threads) {
+    if (n_bodies > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Morton quadtree supports at most 2^32-1 bodies");
+    grow_nodes(2 * n_bodies + 1);
+    level_begin.reserve(MAX_DEPTH + 2);
+}
+
+bool MortonQuadtree::is_leaf(uint32_t node_idx) const {
+    return child_count[node_idx] == 0;
+}
+
+void MortonQuadtree::set_body_count(uint64_t n_bodies) {
+    assert(n_bodies <= sorted_idxs.size());
+    this->n_bodies = n_bodies;
+}
+
+void MortonQuadtree::build_tree(const Bodies& bodies, uint16_t thread_idx,
+        std::barrier<>& sync_point) {
+    const Box box = compute_bounding_box(bodies, thread_idx, sync_point);
+    compute_morton_codes(bodies, box, thread_idx);
+    sync_point.arrive_and_wait();
+    const uint64_t* sorted_keys = sort_by_morton(bodies, thread_idx, sync_point);
+    build_tree_topology(sorted_keys, thread_idx, sync_point);
+    propagate_com_up(thread_idx, sync_point);
+}
+
+std::pair<uint64_t, uint64_t> MortonQuadtree::thread_chunk(uint64_t begin, uint64_t end,
+        uint16_t thread_idx) const {
+    const uint64_t size = end - begin;
+    return {begin + size * thread_idx / n_threads, begin + size * (thread_idx + 1) / n_threads};
+}
+
+// Every thread reduces its own chunk, then all threads reduce the per-thread boxes. The returned
+// box is squared so that quadrants stay square, as in BarnesHutCuda::compute_bounding_box.
+MortonQuadtree::Box MortonQuadtree::compute_bounding_box(const Bodies& bodies,
+        uint16_t thread_idx, std::barrier<>& sync_point) {
+    const auto [begin, end] = thread_chunk(0, n_bodies, thread_idx);
+    Box local{.x_min = std::numeric_limits<double>::max(),
+            .x_max = std::numeric_limits<double>::lowest(),
+            .y_min = std::numeric_limits<double>::max(),
+            .y_max = std::numeric_limits<double>::lowest()};
+    const std::span<const double> x = bodies.x();
+    const std::span<const double> y = bodies.y();
+    for (uint64_t i = begin; i < end; i++) {
+        local.x_min = std::min(local.x_min, x[i]);
+        local.x_max = std::max(local.x_max, x[i]);
+        local.y_min = std::min(local.y_min, y[i]);
+        local.y_max = std::max(local.y_max, y[i]);
+    }
+    thread_boxes[thread_idx] = local;
+    sync_point.arrive_and_wait();
+
+    Box box = thread_boxes[0];
+    for (uint16_t t = 1; t < n_threads; t++) {
+        box.x_min = std::min(box.x_min, thread_boxes[t].x_min);
+        box.x_max = std::max(box.x_max, thread_boxes[t].x_max);
+        box.y_min = std::min(box.y_min, thread_boxes[t].y_min);
+        box.y_max = std::max(box.y_max, thread_boxes[t].y_max);
+    }
+
+    // Square the bounding box
+    const double x_range = box.x_max - box.x_min;
+    const double y_range = box.y_max - box.y_min;
+    if (x_range > y_range) {
+        const double mid = (box.y_min + box.y_max) * 0.5;
+        box.y_min = mid - x_range * 0.5;
+        box.y_max = mid + x_range * 0.5;
+    }
+    else {
+        const double mid = (box.x_min + box.x_max) * 0.5;
+        box.x_min = mid - y_range * 0.5;
+        box.x_max = mid + y_range * 0.5;
+    }
+
+    // Root node. Other threads first read it after the sort, which ends with a barrier.
+    if (thread_idx == 0) {
+        const double side = box.x_max - box.x_min;
+        width_sq[0] = 2.0 * side * side;  // diagonal, like Quad::boundaries.size.lengthSquared()
+        body_begin[0] = 0;
+        body_end[0] = n_bodies;
+        first_child[0] = 0;
+        child_count[0] = 0;
+    }
+    return box;
+}
+
+void MortonQuadtree::compute_morton_codes(const Bodies& bodies, const Box& box,
+        uint16_t thread_idx) {
+    const auto [begin, end] = thread_chunk(0, n_bodies, thread_idx);
+    const double side = box.x_max - box.x_min;
+    const double inv_side = side > 0.0 ? 1.0 / side : 0.0;
+    const std::span<const double> x = bodies.x();
+    const std::span<const double> y = bodies.y();
+    for (uint64_t i = begin; i < end; i++) {
+        keys[i] = morton_2d((x[i] - box.x_min) * inv_side, (y[i] - box.y_min) * inv_side);
+        idxs[i] = i;
+    }
+}
+
+// Parallel LSD radix sort of (key, index) pairs, followed by a gather of the body data into
+// Morton order. Digits that are equal for every key are skipped.
+const uint64_t* MortonQuadtree::sort_by_morton(const Bodies& bodies, uint16_t thread_idx,
+        std::barrier<>& sync_point) {
+    const auto [begin, end] = thread_chunk(0, n_bodies, thread_idx);
+    uint64_t* src_keys = keys.data();
+    uint64_t* dst_keys = keys_alt.data();
+    uint32_t* src_idxs = idxs.data();
+    uint32_t* dst_idxs = idxs_alt.data();
+
+    for (uint32_t shift = 0; shift < 64; shift += RADIX_BITS) {
+        auto& histogram = thread_histograms[thread_idx];
+        histogram.fill(0);
+        for (uint64_t i = begin; i < end; i++) {
+            histogram[(src_keys[i] >> shift) & (RADIX - 1)]++;
+        }
+        sync_point.arrive_and_wait();
+
+        std::array<uint32_t, RADIX> offsets;
+        uint32_t digit_base = 0;
+        bool trivial = false;
+        for (uint32_t d = 0; d < RADIX; d++) {
+            uint32_t digit_total = 0;
+            uint32_t preceding = 0;
+            for (uint16_t t = 0; t < n_threads; t++) {
+                if (t == thread_idx)
+                    preceding = digit_total;
+                digit_total += thread_histograms[t][d];
+            }
+            trivial |= digit_total == n_bodies;
+            offsets[d] = digit_base + preceding;
+            digit_base += digit_total;
+        }
+
+        if (!trivial) {
+            for (uint64_t i = begin; i < end; i++) {
+                const uint32_t dst = offsets[(src_keys[i] >> shift) & (RADIX - 1)]++;
+                dst_keys[dst] = src_keys[i];
+                dst_idxs[dst] = src_idxs[i];
+            }
+            std::swap(src_keys, dst_keys);
+            std::swap(src_idxs, dst_idxs);
+        }
+        sync_point.arrive_and_wait();
+    }
+
+    const std::span<const double> x = bodies.x();
+    const std::span<const double> y = bodies.y();
+    const std::span<const double> mass = bodies.masses();
+    for (uint64_t i = begin; i < end; i++) {
+        const uint32_t body_idx = src_idxs[i];
+        sorted_idxs[i] = body_idx;
+        sorted_x[i] = x[body_idx];
+        sorted_y[i] = y[body_idx];
+        sorted_mass[i] = mass[body_idx];
+    }
+    return src_keys;
+}
+
+// Level-by-level topology build. Each level is split across threads; a node finds its child
+// ranges by binary searching the 2 Morton bits of the level. Per-thread child counts are prefix
+// summed so that child nodes are allocated contiguously and in a deterministic order.
+void MortonQuadtree::build_tree_topology(const uint64_t* sorted_keys, uint16_t thread_idx,
+        std::barrier<>& sync_point) {
+    const auto find_splits = [sorted_keys](uint32_t begin, uint32_t end, uint32_t level) {
+        const uint32_t shift = 62 - level * 2;
+        return std::array<uint32_t, 5>{begin,
+                lower_bound_quadrant(sorted_keys, begin, end, 1ull, shift),
+                lower_bound_quadrant(sorted_keys, begin, end, 2ull, shift),
+                lower_bound_quadrant(sorted_keys, begin, end, 3ull, shift), end};
+    };
+
+    if (thread_idx == 0) {
+        level_begin.clear();
+        level_begin.push_back(0);
+        level_begin.push_back(1);
+    }
+    uint32_t level_start = 0;
+    uint32_t level_end = 1;
+
+    for (uint32_t level = 0; level_start < level_end; level++) {
+        const auto [begin, end] = thread_chunk(level_start, level_end, thread_idx);
+        // Read before the barrier, thread 0 may grow the node arrays right after it
+        const uint64_t capacity = mass.size();
+
+        uint32_t count = 0;
+        for (uint32_t node = begin; node < end; node++) {
+            child_count[node] = 0;
+            if (body_end[node] - body_begin[node] <= leaf_size || level >= MAX_DEPTH)
+                continue;
+            const auto splits = find_splits(body_begin[node], body_end[node], level);
+            for (uint32_t q = 0; q < 4; q++) {
+                child_count[node] += splits[q] < splits[q + 1];
+            }
+            count += child_count[node];
+        }
+        thread_node_counts[thread_idx] = count;
+        sync_point.arrive_and_wait();
+
+        uint32_t next = level_end;
+        uint32_t total = 0;
+        for (uint16_t t = 0; t < n_threads; t++) {
+            if (t == thread_idx)
+                next = level_end + total;
+            total += thread_node_counts[t];
+        }
+        if (level_end + total > capacity) {
+            if (thread_idx == 0)
+                grow_nodes(level_end + total);
+            sync_point.arrive_and_wait();
+        }
+
+        for (uint32_t node = begin; node < end; node++) {
+            if (child_count[node] == 0)
+                continue;
+            const auto splits = find_splits(body_begin[node], body_end[node], level);
+            first_child[node] = next;
+            for (uint32_t q = 0; q < 4; q++) {
+                if (splits[q] == splits[q + 1])
+                    continue;
+                width_sq[next] = width_sq[node] * 0.25;
+                body_begin[next] = splits[q];
+                body_end[next] = splits[q + 1];
+                next++;
+            }
+        }
+        if (thread_idx == 0)
+            level_begin.push_back(level_end + total);
+        sync_point.arrive_and_wait();
+
+        level_start = level_end;
+        level_end += total;
+    }
+}
+
+// Bottom-up, deepest level first. Leaves sum their Morton ordered bodies, internal nodes their
+// children.
+void MortonQuadtree::propagate_com_up(uint16_t thread_idx, std::barrier<>& sync_point) {
+    for (uint32_t level = level_begin.size() - 1; level-- > 0;) {
+        const auto [begin, end] = thread_chunk(level_begin[level], level_begin[level + 1],
+                thread_idx);
+        for (uint32_t node = begin; node < end; node++) {
+            double M = 0.0, Rx = 0.0, Ry = 0.0;
+            subtree_size[node] = 1;
+            if (body_end[node] - body_begin[node] == 1) {
+                // Exact position, so a body can recognise its own leaf during the walk
+                const uint32_t i = body_begin[node];
+                mass[node] = sorted_mass[i];
+                com_x[node] = sorted_x[i];
+                com_y[node] = sorted_y[i];
+                continue;
+            }
+            if (is_leaf(node)) {
+                for (uint32_t i = body_begin[node]; i < body_end[node]; i++) {
+                    M += sorted_mass[i];
+                    Rx += sorted_mass[i] * sorted_x[i];
+                    Ry += sorted_mass[i] * sorted_y[i];
+                }
+            }
+            else {
+                const uint32_t children_end = first_child[node] + child_count[node];
+                for (uint32_t child = first_child[node]; child < children_end; child++) {
+                    M += mass[child];
+                    Rx += mass[child] * com_x[child];
+                    Ry += mass[child] * com_y[child];
+                    subtree_size[node] += subtree_size[child];
+                }
+            }
+            mass[node] = M;
+            com_x[node] = M != 0.0 ? Rx / M : 0.0;
+            com_y[node] = M != 0.0 ? Ry / M : 0.0;
+        }
+        sync_point.arrive_and_wait();
+    }
+}
+
+// Top-down, one level at a time. A node's packed position and the position of its children block
+// are known once its parent has been placed: the children block of the first child follows the
+// parent's children block, and every next sibling's follows the subtree of the previous sibling.
+void MortonQuadtree::pack(ForceTree& force_tree, uint16_t thread_idx,
+        std::barrier<>& sync_point) {
+    if (thread_idx == 0) {
+        force_tree.nodes.resize(level_begin.back());
+        force_tree.body_idxs.resize(n_bodies);
+        force_tree.body_x.resize(n_bodies);
+        force_tree.body_y.resize(n_bodies);
+        force_tree.body_mass.resize(n_bodies);
+        packed_idx[0] = 0;
+        packed_children_idx[0] = 1;
+        packed_next[0] = ForceTree::END;
+    }
+    sync_point.arrive_and_wait();
+
+    const auto [body_begin_idx, body_end_idx] = thread_chunk(0, n_bodies, thread_idx);
+    std::copy(sorted_idxs.begin() + body_begin_idx, sorted_idxs.begin() + body_end_idx,
+            force_tree.body_idxs.begin() + body_begin_idx);
+    std::copy(sorted_x.begin() + body_begin_idx, sorted_x.begin() + body_end_idx,
+            force_tree.body_x.begin() + body_begin_idx);
+    std::copy(sorted_y.begin() + body_begin_idx, sorted_y.begin() + body_end_idx,
+            force_tree.body_y.begin() + body_begin_idx);
+    std::copy(sorted_mass.begin() + body_begin_idx, sorted_mass.begin() + body_end_idx,
+            force_tree.body_mass.begin() + body_begin_idx);
+
+    for (uint32_t level = 0; level + 1 < level_begin.size(); level++) {
+        const auto [begin, end] = thread_chunk(level_begin[level], level_begin[level + 1],
+                thread_idx);
+        for (uint32_t node = begin; node < end; node++) {
+            const uint32_t children_idx = packed_children_idx[node];
+            force_tree.nodes[packed_idx[node]] = ForceTree::Node{.com_x = com_x[node],
+                    .com_y = com_y[node],
+                    .mass = mass[node],
+                    .width_sq = width_sq[node],
+                    .first_child = child_count[node] != 0 ? children_idx : 0,
+                    .next = packed_next[node],
+                    .body_begin = body_begin[node],
+                    .body_end = body_end[node]};
+            uint32_t grandchildren_idx = children_idx + child_count[node];
+            for (uint32_t i = 0; i < child_count[node]; i++) {
+                const uint32_t child = first_child[node] + i;
+                packed_idx[child] = children_idx + i;
+                packed_children_idx[child] = grandchildren_idx;
+                packed_next[child] =
+                        i + 1 < child_count[node] ? children_idx + i + 1 : packed_next[node];
+                grandchildren_idx += subtree_size[child] - 1;
+            }
+        }
+        sync_point.arrive_and_wait();
+    }
+}
+
+// Only called by a single thread while the others wait on the barrier
+void MortonQuadtree::grow_nodes(uint64_t min_size) {
+    const uint64_t new_size = std::max<uint64_t>(min_size, mass.size() * 3 / 2);
+    mass.resize(new_size);
+    com_x.resize(new_size);
+    com_y.resize(new_size);
+    width_sq.resize(new_size);
+    first_child.resize(new_size);
+    child_count.resize(new_size);
+    body_begin.resize(new_size);
+    body_end.resize(new_size);
+    subtree_size.resize(new_size);
+    packed_idx.resize(new_size);
+    packed_children_idx.resize(new_size);
+    packed_next.resize(new_size);
+}
@@ -1,6 +1,8 @@
 #include "Quadtree/Quadtree.hpp"
 
+#include <algorithm>
 #include <limits>
+#include <numeric>
 
 #include "Body/Body.hpp"
 #include "Logger/Logger.hpp"
@@ -12,20 +14,13 @@ sf::Rect<double> get_universe_boundaries(const Bodies& bodies) {
     double min_y = std::numeric_limits<double>::max();
     double max_y = std::numeric_limits<double>::lowest();
 
+    const std::span<const double> x = bodies.x();
+    const std::span<const double> y = bodies.y();
     for (uint64_t i = 0; i < bodies.n; i++) {
-        if (bodies.pos(i).x < min_x) {
-            min_x = bodies.pos(i).x;
-        }
-        else if (bodies.pos(i).x > max_x) {
-            max_x = bodies.pos(i).x;
-        }
-
-        if (bodies.pos(i).y < min_y) {
-            min_y = bodies.pos(i).y;
-        }
-        else if (bodies.pos(i).y > max_y) {
-            max_y = bodies.pos(i).y;
-        }
+        min_x = std::min(min_x, x[i]);
+        max_x = std::max(max_x, x[i]);
+        min_y = std::min(min_y, y[i]);
+        max_y = std::max(max_y, y[i]);
     }
     return {{min_x, min_y}, {max_x - min_x, max_y - min_y}};
 }
@@ -36,10 +31,26 @@ bool Quad::is_leaf() const {
     return top_left_idx == 0;
 }
 
-Quadtree::Quadtree() {}
+// Bodies sharing a position can never be separated, stop splitting at this depth
+constexpr uint32_t PARTITION_MAX_DEPTH = 64;
+// Refit: the root of a tree built for refitting is grown by this fraction of its size on every
+// side, so that the outermost bodies do not force a rebuild on every step
+constexpr double REFIT_ROOT_MARGIN = 0.05;
+// Refit: a full rebuild happens when more bodies than this fraction changed leaf in a step, when a
+// leaf grew past this multiple of the leaf size, or after this many refits in a row
+constexpr double REFIT_MAX_MIGRATED_FRACTION = 0.05;
+constexpr uint32_t REFIT_MAX_LEAF_OVERFLOW = 4;
+constexpr uint32_t REFIT_MAX_REFITS = 64;
+
+Quadtree::Quadtree(BuildMode build_mode, uint32_t leaf_size)
+        : build_mode(build_mode), leaf_size(leaf_size) {}
 
 Quadtree::~Quadtree() {}
 
+Quadtree::BuildMode Quadtree::get_build_mode() const {
+    return build_mode;
+}
+
 void Quadtree::fill_tree_recursive(uint32_t quad_idx) {
     Quad* quad = &quads[quad_idx];
     if (quad->body_count == 0) {
@@ -50,7 +61,17 @@ void Quadtree::fill_tree_recursive(uint32_t quad_idx) {
         quad->center_of_mass = bodies->pos(body_idx);
         quad->total_mass = bodies->mass(body_idx);
         quad->momentum = bodies->vel(body_idx) * bodies->mass(body_idx);
-        quad->body_idxs.clear();
+        return;
+    }
+    else if (quad->body_count <= leaf_size) {
+        quad->total_mass = 0;
+        for (const auto body_idx : quad->body_idxs) {
+            quad->center_of_mass += bodies->pos(body_idx) * bodies->mass(body_idx);
+            quad->total_mass += bodies->mass(body_idx);
+            quad->momentum += bodies->vel(body_idx) * bodies->mass(body_idx);
+        }
+        if (quad->total_mass != 0)
+            quad->center_of_mass /= quad->total_mass;
         return;
     }
 
@@ -112,26 +133,269 @@ void Quadtree::fill_tree_recursive(uint32_t quad_idx) {
     fill_tree_recursive(top_left_idx + 2);
     fill_tree_recursive(top_left_idx + 3);
 
-    quad = &quads[quad_idx];
-    top_left = &quads[top_left_idx];
-    top_right = top_left + 1;
-    bottom_left = top_left + 2;
-    bottom_right = top_left + 3;
+    aggregate_children(quad_idx);
+}
+
+// Quicksort-like: the quad's body range is split on y and then each half on x
+void Quadtree::partition_tree_recursive(uint32_t quad_idx, uint32_t depth) {
+    Quad* quad = &quads[quad_idx];
+    if (quad->body_count == 0) {
+        return;
+    }
+    else if (quad->body_count == 1) {
+        const auto body_idx = body_idx_array[quad->body_begin];
+        quad->center_of_mass = bodies->pos(body_idx);
+        quad->total_mass = bodies->mass(body_idx);
+        quad->momentum = bodies->vel(body_idx) * bodies->mass(body_idx);
+        return;
+    }
+    else if (quad->body_count <= leaf_size || depth == PARTITION_MAX_DEPTH) {
+        for (uint32_t i = quad->body_begin; i < quad->body_end; i++) {
+            const auto body_idx = body_idx_array[i];
+            quad->center_of_mass += bodies->pos(body_idx) * bodies->mass(body_idx);
+            quad->total_mass += bodies->mass(body_idx);
+            quad->momentum += bodies->vel(body_idx) * bodies->mass(body_idx);
+        }
+        if (quad->total_mass != 0)
+            quad->center_of_mass /= quad->total_mass;
+        return;
+    }
+
+    const auto center = quad->boundaries.getCenter();
+    const auto top_left_pos = quad->boundaries.position;
+    const auto half_size = quad->boundaries.size / 2.0;
+    const uint32_t top_left_idx = quads.size();
+
+    const auto begin = body_idx_array.begin() + quad->body_begin;
+    const auto end = body_idx_array.begin() + quad->body_end;
+    const auto is_left = [this, &center](uint32_t body_idx) {
+        return bodies->pos(body_idx).x < center.x;
+    };
+    const auto is_top = [this, &center](uint32_t body_idx) {
+        return bodies->pos(body_idx).y < center.y;
+    };
+    const auto top_end = std::partition(begin, end, is_top);
+    const auto top_left_end = std::partition(begin, top_end, is_left);
+    const auto bottom_left_end = std::partition(top_end, end, is_left);
+    const uint32_t splits[5] = {quad->body_begin,
+            static_cast<uint32_t>(top_left_end - body_idx_array.begin()),
+            static_cast<uint32_t>(top_end - body_idx_array.begin()),
+            static_cast<uint32_t>(bottom_left_end - body_idx_array.begin()), quad->body_end};
+
+    quad->top_left_idx = top_left_idx;
+    // Stmts below invalidate quad references by appending to the vector
+    quads.emplace_back(Quad{{top_left_pos, half_size}});
+    quads.emplace_back(Quad{{{center.x, top_left_pos.y}, half_size}});
+    quads.emplace_back(Quad{{{top_left_pos.x, center.y}, half_size}});
+    quads.emplace_back(Quad{{center, half_size}});
+
+    for (uint32_t q = 0; q < 4; q++) {
+        Quad& child = quads[top_left_idx + q];
+        child.body_begin = splits[q];
+        child.body_end = splits[q + 1];
+        child.body_count = splits[q + 1] - splits[q];
+    }
+
+    partition_tree_recursive(top_left_idx, depth + 1);
+    partition_tree_recursive(top_left_idx + 1, depth + 1);
+    partition_tree_recursive(top_left_idx + 2, depth + 1);
+    partition_tree_recursive(top_left_idx + 3, depth + 1);
+
+    aggregate_children(quad_idx);
+}
+
+void Quadtree::aggregate_children(uint32_t quad_idx) {
+    Quad* quad = &quads[quad_idx];
+    Quad* top_left = &quads[quad->top_left_idx];
+    Quad* top_right = top_left + 1;
+    Quad* bottom_left = top_left + 2;
+    Quad* bottom_right = top_left + 3;
 
     quad->total_mass = top_left->total_mass + top_right->total_mass + bottom_left->total_mass
                        + bottom_right->total_mass;
 
-    quad->center_of_mass = (top_left->center_of_mass * top_left->total_mass
-                                   + bottom_right->center_of_mass * bottom_right->total_mass
-                                   + bottom_left->center_of_mass * bottom_left->total_mass
-                                   + top_right->center_of_mass * top_right->total_mass)
-                           / quad->total_mass;
+    quad->center_of_mass = top_left->center_of_mass * top_left->total_mass
+                           + bottom_right->center_of_mass * bottom_right->total_mass
+                           + bottom_left->center_of_mass * bottom_left->total_mass
+                           + top_right->center_of_mass * top_right->total_mass;
+    if (quad->total_mass != 0)
+        quad->center_of_mass /= quad->total_mass;
 
     quad->momentum = top_left->momentum + top_right->momentum + bottom_left->momentum
                      + bottom_right->momentum;
 }
 
 void Quadtree::build_tree(const Bodies& bodies) {
+    build(bodies, 0.0);
+}
+
+void Quadtree::refit_tree(const Bodies& bodies) {
+    assert(build_mode == BuildMode::PARTITION);
+    if (this->bodies != &bodies || quads.empty() || body_idx_array.size() != bodies.n
+            || !try_refit()) {
+        build(bodies, REFIT_ROOT_MARGIN);
+        refit_stats.rebuilds++;
+        refits_since_build = 0;
+        return;
+    }
+    refit_stats.refits++;
+    refits_since_build++;
+}
+
+void Quadtree::reorder_bodies(std::span<const uint32_t> order) {
+    if (body_idx_array.size() != order.size())
+        return;
+    std::vector<uint32_t> new_idxs(order.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        new_idxs[order[i]] = i;
+    }
+    for (uint32_t& body_idx : body_idx_array) {
+        body_idx = new_idxs[body_idx];
+    }
+}
+
+const Quadtree::RefitStats& Quadtree::get_refit_stats() const {
+    return refit_stats;
+}
+
+// Returns false, leaving the tree untouched, if the tree should be rebuilt instead
+bool Quadtree::try_refit() {
+    if (refits_since_build >= REFIT_MAX_REFITS)
+        return false;
+    const sf::Rect<double> universe = get_universe_boundaries(*bodies);
+    const sf::Rect<double>& root_boundaries = quads[0].boundaries;
+    if (universe.position.x < root_boundaries.position.x
+            || universe.position.y < root_boundaries.position.y
+            || universe.position.x + universe.size.x
+                       >= root_boundaries.position.x + root_boundaries.size.x
+            || universe.position.y + universe.size.y
+                       >= root_boundaries.position.y + root_boundaries.size.y)
+        return false;
+
+    // Bodies well inside their leaf stay, the others are located from the root with the same
+    // comparisons as the build, so rounding at the cell edges cannot misplace them
+    const double tolerance = 1e-12 * std::max(root_boundaries.size.x, root_boundaries.size.y);
+    const uint64_t max_migrated = REFIT_MAX_MIGRATED_FRACTION * bodies->n;
+    const std::span<const double> x = bodies->x();
+    const std::span<const double> y = bodies->y();
+    uint64_t migrated = 0;
+    leaf_targets.resize(body_idx_array.size());
+    for (uint32_t quad_idx = 0; quad_idx < quads.size(); quad_idx++) {
+        const Quad& quad = quads[quad_idx];
+        if (!quad.is_leaf())
+            continue;
+        const sf::Rect<double>& b = quad.boundaries;
+        for (uint32_t i = quad.body_begin; i < quad.body_end; i++) {
+            const sf::Vector2<double> pos = {x[body_idx_array[i]], y[body_idx_array[i]]};
+            const bool inside = pos.x > b.position.x + tolerance
+                                && pos.x < b.position.x + b.size.x - tolerance
+                                && pos.y > b.position.y + tolerance
+                                && pos.y < b.position.y + b.size.y - tolerance;
+            leaf_targets[i] = inside ? quad_idx : find_leaf(pos);
+            migrated += leaf_targets[i] != quad_idx;
+        }
+        if (migrated > max_migrated)
+            return false;
+    }
+    refit_stats.migrated_bodies += migrated;
+
+    if (migrated != 0) {
+        std::vector<uint32_t>& counts = leaf_cursors;
+        counts.assign(quads.size(), 0);
+        for (const uint32_t target : leaf_targets) {
+            counts[target]++;
+        }
+        for (uint32_t quad_idx = 0; quad_idx < quads.size(); quad_idx++) {
+            const Quad& quad = quads[quad_idx];
+            if (quad.is_leaf() && counts[quad_idx] > quad.body_count
+                    && counts[quad_idx] > REFIT_MAX_LEAF_OVERFLOW * leaf_size)
+                return false;
+        }
+        // New leaf ranges in depth-first order, then a stable scatter of the body indices
+        for (uint32_t quad_idx = 0; quad_idx < quads.size(); quad_idx++) {
+            quads[quad_idx].body_count = counts[quad_idx];
+        }
+        assign_ranges(0, 0);
+        for (uint32_t quad_idx = 0; quad_idx < quads.size(); quad_idx++) {
+            leaf_cursors[quad_idx] = quads[quad_idx].body_begin;
+        }
+        refit_body_idxs.resize(body_idx_array.size());
+        for (uint32_t i = 0; i < body_idx_array.size(); i++) {
+            refit_body_idxs[leaf_cursors[leaf_targets[i]]++] = body_idx_array[i];
+        }
+        body_idx_array.swap(refit_body_idxs);
+    }
+
+    // Children are always appended after their parent, so a reverse sweep is bottom-up
+    for (uint32_t quad_idx = quads.size(); quad_idx-- > 0;) {
+        Quad& quad = quads[quad_idx];
+        if (quad.is_leaf()) {
+            update_leaf(quad_idx);
+            continue;
+        }
+        quad.body_count = 0;
+        for (uint32_t child_idx = quad.top_left_idx; child_idx < quad.top_left_idx + 4; child_idx++)
+            quad.body_count += quads[child_idx].body_count;
+        if (quad.body_count != 0) {
+            aggregate_children(quad_idx);
+        }
+        else {
+            quad.total_mass = 0;
+            quad.center_of_mass = {0.0, 0.0};
+            quad.momentum = {0.0, 0.0};
+        }
+    }
+    return true;
+}
+
+uint32_t Quadtree::find_leaf(const sf::Vector2<double>& pos) const {
+    uint32_t quad_idx = 0;
+    while (!quads[quad_idx].is_leaf()) {
+        const Quad& quad = quads[quad_idx];
+        const auto center = quad.boundaries.getCenter();
+        quad_idx = quad.top_left_idx + (pos.x < center.x ? 0 : 1) + (pos.y < center.y ? 0 : 2);
+    }
+    return quad_idx;
+}
+
+// Lays the quads' body ranges out in depth-first order from their (leaf) body counts
+uint32_t Quadtree::assign_ranges(uint32_t quad_idx, uint32_t begin) {
+    Quad& quad = quads[quad_idx];
+    quad.body_begin = begin;
+    if (quad.is_leaf()) {
+        quad.body_end = begin + quad.body_count;
+        return quad.body_end;
+    }
+    uint32_t end = begin;
+    for (uint32_t child_idx = quad.top_left_idx; child_idx < quad.top_left_idx + 4; child_idx++)
+        end = assign_ranges(child_idx, end);
+    quads[quad_idx].body_end = end;
+    return end;
+}
+
+void Quadtree::update_leaf(uint32_t quad_idx) {
+    Quad& quad = quads[quad_idx];
+    const double* x = bodies->x().data();
+    const double* y = bodies->y().data();
+    const double* vx = bodies->vx().data();
+    const double* vy = bodies->vy().data();
+    const double* m = bodies->mass_data();
+    double mass = 0.0;
+    sf::Vector2<double> weighted_pos = {0.0, 0.0};
+    sf::Vector2<double> momentum = {0.0, 0.0};
+    for (uint32_t i = quad.body_begin; i < quad.body_end; i++) {
+        const uint32_t body_idx = body_idx_array[i];
+        mass += m[body_idx];
+        weighted_pos += sf::Vector2<double>{x[body_idx], y[body_idx]} * m[body_idx];
+        momentum += sf::Vector2<double>{vx[body_idx], vy[body_idx]} * m[body_idx];
+    }
+    quad.body_count = quad.body_end - quad.body_begin;
+    quad.total_mass = mass;
+    quad.center_of_mass = mass != 0.0 ? weighted_pos / mass : weighted_pos;
+    quad.momentum = momentum;
+}
+
+void Quadtree::build(const Bodies& bodies, double root_margin) {
     this->bodies = &bodies;
 
     // After the first tree, we always expect the new one to be similar to the previous.
@@ -140,13 +404,29 @@ void Quadtree::build_tree(const Bodies& bodies) {
     quads.clear();
 
     // insert & init root
-    quads.emplace_back(get_universe_boundaries(bodies));
+    sf::Rect<double> universe = get_universe_boundaries(bodies);
+    universe.position -= universe.size * root_margin;
+    universe.size += universe.size * (2 * root_margin);
+    quads.emplace_back(std::move(universe));
     Quad& root = quads.back();
+    root.body_count = bodies.n;
+
+    if (build_mode == BuildMode::PARTITION) {
+        // The previous iteration's order is kept, it is already nearly partitioned
+        if (body_idx_array.size() != bodies.n) {
+            body_idx_array.resize(bodies.n);
+            std::iota(body_idx_array.begin(), body_idx_array.end(), 0);
+        }
+        root.body_begin = 0;
+        root.body_end = bodies.n;
+        partition_tree_recursive(0, 0);
+        return;
+    }
+
     for (uint64_t i = 0; i < bodies.n; i++) {
         root.body_idxs.push_front(i);
         root.total_mass += bodies.mass(i);
     }
-    root.body_count = bodies.n;
 
     fill_tree_recursive(0);
 }
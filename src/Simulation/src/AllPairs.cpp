@@ -1,49 +1,165 @@
 #include "Simulation/AllPairs.hpp"
 
+#include <algorithm>
+
+#include "Constants/Constants.hpp"
+#include "GravityKernel/GravityKernel.hpp"
+
 
 AllPairsSim::AllPairsSim(const Config::Simulation& sim_cfg, Bodies& bodies)
-        : Simulation(sim_cfg, bodies) {}
+        : ThreadedSimulation(sim_cfg, bodies), n_blocks(2 * n_threads) {}
 
 AllPairsSim::~AllPairsSim() {
-    if (sim_thread.joinable()) {
-        on_pause();
+    on_pause();
+}
+
+// Every thread runs the integrator stages on its own bodies, the force evaluations between them
+// are shared
+void AllPairsSim::step(uint16_t thread_idx) {
+    if (block_timesteps.enabled()) {
+        block_step(thread_idx);
+        return;
+    }
+    const auto [begin_idx, end_idx] = thread_range(thread_idx);
+    if (needs_initial_forces())
+        evaluate_forces(thread_idx);
+    for (uint32_t stage = 0; stage <= integrator.stages(); stage++) {
+        integrator.advance(bodies, stage, timestep, begin_idx, end_idx);
+        sync_point.arrive_and_wait();
+        if (stage < integrator.stages() && integrator.kicks_after(stage))
+            evaluate_forces(thread_idx);
+    }
+}
+
+// Every thread starts and drifts its own bodies, the active bodies of a sub-step are shared. The
+// master picks them between the barriers, while nobody reads them.
+void AllPairsSim::block_step(uint16_t thread_idx) {
+    const bool master = thread_idx == n_threads - 1;
+    const auto [begin_idx, end_idx] = thread_range(thread_idx);
+    if (needs_initial_forces()) {
+        if (master)
+            block_timesteps.activate_all();
+        sync_point.arrive_and_wait();
+        evaluate_forces(thread_idx);
+    }
+    block_timesteps.start(bodies, timestep, begin_idx, end_idx);
+    for (uint32_t substep = 0; substep < block_timesteps.substeps(); substep++) {
+        block_timesteps.drift(bodies, timestep, begin_idx, end_idx);
+        if (master)
+            block_timesteps.collect_active(substep);
+        sync_point.arrive_and_wait();
+        evaluate_forces(thread_idx);
+        const uint64_t n_active = block_timesteps.n_active();
+        block_timesteps.finish(bodies, timestep, n_active * thread_idx / n_threads,
+                n_active * (thread_idx + 1) / n_threads);
+        sync_point.arrive_and_wait();
     }
 }
 
-void AllPairsSim::on_run() {
-    stop = false;
-    sim_thread = std::thread(&AllPairsSim::simulate, this);
+std::pair<uint64_t, uint64_t> AllPairsSim::thread_range(uint16_t thread_idx) const {
+    return {bodies.n * thread_idx / n_threads, bodies.n * (thread_idx + 1) / n_threads};
 }
 
-void AllPairsSim::on_pause() {
-    stop = true;
-    sim_thread.join();
+std::pair<uint64_t, uint64_t> AllPairsSim::block_range(uint32_t block) const {
+    return {bodies.n * block / n_blocks, bodies.n * (block + 1) / n_blocks};
 }
 
-void AllPairsSim::simulate() {
-    while (!should_stop()) {
-        update_positions();
-        update_velocities();
-        post_iteration();
+// The forces are summed in the accelerations of the bodies, which every thread scales in its own
+// range once all the tiles are done. With only some bodies active (block timesteps), the
+// accelerations of those are summed directly and the barrier comes last, the bodies are shared.
+// Once every active body is claimed the master rewinds the counter, the next claims are at least
+// one barrier away.
+void AllPairsSim::evaluate_forces(uint16_t thread_idx) {
+    const auto [begin_idx, end_idx] = thread_range(thread_idx);
+    if (!block_timesteps.all_active()) {
+        update_active_accelerations();
+        sync_point.arrive_and_wait();
+        if (thread_idx == n_threads - 1)
+            row_counter.store(0, std::memory_order::relaxed);
+        return;
     }
+    accumulate_forces(thread_idx);
+    update_accelerations(begin_idx, end_idx);
 }
 
-void AllPairsSim::update_positions() {
-    for (uint64_t i = 0; i < bodies.n; i++) {
-        bodies.pos(i) += bodies.vel(i) * timestep;
+// A round robin tournament of the blocks (circle method): in every round each thread takes one
+// pair of blocks, which no other thread touches, so the pairs are summed without per-thread
+// buffers. Every two blocks meet once over n_blocks - 1 rounds, separated by barriers. The first
+// round sums the pairs within the thread's own blocks, which also clears their sums.
+void AllPairsSim::accumulate_forces(uint16_t thread_idx) {
+    const auto [begin_idx, end_idx] = thread_range(thread_idx);
+    std::fill(bodies.ax().begin() + begin_idx, bodies.ax().begin() + end_idx, 0.0);
+    std::fill(bodies.ay().begin() + begin_idx, bodies.ay().begin() + end_idx, 0.0);
+    accumulate_tile(2 * thread_idx, 2 * thread_idx);
+    accumulate_tile(2 * thread_idx + 1, 2 * thread_idx + 1);
+    sync_point.arrive_and_wait();
+
+    const uint32_t n_rounds = n_blocks - 1;
+    for (uint32_t round = 0; round < n_rounds; round++) {
+        if (thread_idx == 0) {
+            accumulate_tile(round, n_blocks - 1);
+        }
+        else {
+            accumulate_tile((round + thread_idx) % n_rounds,
+                    (round + n_rounds - thread_idx) % n_rounds);
+        }
+        sync_point.arrive_and_wait();
     }
 }
 
-// This algorithm only iterates each pair once calculating the forces both ways
-void AllPairsSim::update_velocities() {
-    for (uint64_t i = 0; i < bodies.n; i++) {
-        sf::Vector2<double> force_sum = {0.0, 0.0};
-        for (uint64_t j = i + 1; j < bodies.n; j++) {
-            const sf::Vector2<double> f =
-                    force(bodies.pos(i), bodies.pos(j), bodies.mass(i), bodies.mass(j));
-            bodies.vel(j) -= f / bodies.mass(j) * timestep;
-            force_sum += f;
+// The pairs between two blocks, or within a block. This algorithm only iterates each pair once
+// calculating the forces both ways. The forces are summed without G, it is applied once at the
+// end.
+void AllPairsSim::accumulate_tile(uint32_t block_a, uint32_t block_b) {
+    const auto [a_begin, a_end] = block_range(block_a);
+    const auto [b_begin, b_end] = block_range(block_b);
+    const double* x = bodies.x().data();
+    const double* y = bodies.y().data();
+    const double* mass = bodies.mass_data();
+    double* fx = bodies.ax().data();
+    double* fy = bodies.ay().data();
+    for (uint64_t i = a_begin; i < a_end; i++) {
+        const uint64_t j = block_a == block_b ? i + 1 : b_begin;
+        const Gravity::Sources sources = {x + j, y + j, mass + j, static_cast<uint32_t>(b_end - j)};
+        Gravity::symmetric_forces(x[i], y[i], mass[i], sources, epsilon_squared, fx[i], fy[i],
+                fx + j, fy + j);
+    }
+}
+
+// Every active body sums all the others, the pairs between two active bodies are computed twice.
+// The kernel skips a body's own position.
+void AllPairsSim::update_active_accelerations() {
+    const std::span<const uint32_t> active = block_timesteps.active_bodies();
+    const Gravity::Sources sources = {bodies.x().data(), bodies.y().data(), bodies.mass_data(),
+            static_cast<uint32_t>(bodies.n)};
+    const std::span<double> ax = bodies.ax();
+    const std::span<double> ay = bodies.ay();
+    while (true) {
+        const uint64_t begin = row_counter.fetch_add(
+                Constants::Simulation::DYNAMIC_CHUNK_BODIES, std::memory_order::relaxed);
+        if (begin >= active.size())
+            break;
+        const uint64_t end = std::min<uint64_t>(
+                begin + Constants::Simulation::DYNAMIC_CHUNK_BODIES, active.size());
+        for (uint64_t k = begin; k < end; k++) {
+            const uint32_t i = active[k];
+            double acc_x = 0.0;
+            double acc_y = 0.0;
+            Gravity::accelerations(&bodies.x()[i], &bodies.y()[i], 1, sources, epsilon_squared,
+                    &acc_x, &acc_y);
+            ax[i] = Constants::Simulation::G * acc_x;
+            ay[i] = Constants::Simulation::G * acc_y;
         }
-        bodies.vel(i) += force_sum / bodies.mass(i) * timestep;
+    }
+}
+
+// Turns the summed forces of the bodies [begin_idx, end_idx) into accelerations
+void AllPairsSim::update_accelerations(uint64_t begin_idx, uint64_t end_idx) {
+    const std::span<double> ax = bodies.ax();
+    const std::span<double> ay = bodies.ay();
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        const double scale = Constants::Simulation::G / bodies.mass(i);
+        ax[i] *= scale;
+        ay[i] *= scale;
     }
 }
@@ -1,135 +1,844 @@
 #include "Simulation/BarnesHut.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "GravityKernel/GravityKernel.hpp"
+#include "Logger/Distance.hpp"
 #include "Logger/Logger.hpp"
 
+// RESPA: the erfc split of TreePM, erfc(u) + 2u exp(-u^2) / sqrt(pi) with u = R / 2 r_s. erfc is
+// Abramowitz & Stegun 7.1.26 (error under 1.5e-7), unlike std::erfc it vectorizes.
+static double erfc_split(double u) {
+    const double t = 1.0 / (1.0 + 0.3275911 * u);
+    double erfc_poly = 1.061405429;
+    erfc_poly = erfc_poly * t - 1.453152027;
+    erfc_poly = erfc_poly * t + 1.421413741;
+    erfc_poly = erfc_poly * t - 0.284496736;
+    erfc_poly = erfc_poly * t + 0.254829592;
+    return (erfc_poly * t + 2.0 * u / std::sqrt(M_PI)) * std::exp(-u * u);
+}
 
-BarnesHut::BarnesHut(const Config::Simulation& sim_cfg, Bodies& bodies)
-        : Simulation(sim_cfg, bodies), n_threads(sim_cfg.threads),
-          theta_sq(sim_cfg.theta * sim_cfg.theta), worker_chunk(bodies.n / n_threads),
-          master_offset(worker_chunk * (n_threads - 1)), sync_point(n_threads) {
-    if (sim_cfg.threads == 0)
-        throw std::runtime_error("Thread count 0 is invalid");
-    if (sim_cfg.threads > bodies.n)
-        throw std::runtime_error("Threads must be less than the number of bodies");
-    workers.reserve(sim_cfg.threads - 1);
+void BarnesHut::InteractionList::clear() {
+    x.clear();
+    y.clear();
+    mass.clear();
+    accepted_nodes.clear();
+}
+
+void BarnesHut::InteractionList::push_back(double x, double y, double mass) {
+    this->x.push_back(x);
+    this->y.push_back(y);
+    this->mass.push_back(mass);
 }
 
+BarnesHut::BarnesHut(const Config::Simulation& sim_cfg, Bodies& bodies)
+        : ThreadedSimulation(sim_cfg, bodies), theta_sq(sim_cfg.theta * sim_cfg.theta),
+          tree_builder(sim_cfg.tree_builder),
+          tree_refit(sim_cfg.tree_refit), quadrupole(sim_cfg.quadrupole), walk(sim_cfg.walk),
+          scheduler(sim_cfg.scheduler), reorder_interval(sim_cfg.reorder_interval),
+          respa_interval(sim_cfg.respa_interval),
+          respa_split(sim_cfg.respa_split),
+          respa_cutoff_sq(std::pow(Constants::Simulation::RESPA_CUTOFF_SPLITS * respa_split, 2)),
+          respa_cutoff_share(erfc_split(0.5 * Constants::Simulation::RESPA_CUTOFF_SPLITS)),
+          qtree(tree_builder == Config::Simulation::TreeBuilder::PARTITION
+                                ? Quadtree::BuildMode::PARTITION
+                                : Quadtree::BuildMode::LINKED_LIST,
+                  sim_cfg.leaf_size),
+          morton_tree(tree_builder == Config::Simulation::TreeBuilder::MORTON ? bodies.n : 0,
+                  n_threads, sim_cfg.leaf_size),
+          binaries(sim_cfg, epsilon_squared, bodies.n), mergers(sim_cfg, bodies.n, n_threads),
+          interaction_lists(n_threads), far_lists(n_threads), thread_stats(n_threads),
+          body_costs(bodies.n, 1), zone_begin(n_threads + 1),
+          far_ax(respa_interval > 1 ? bodies.n : 0), far_ay(far_ax.size()) {}
+
 BarnesHut::~BarnesHut() {
-    if (master.joinable()) {
-        on_pause();
-    }
+    on_pause();
 
-    StopWatch sw_total = sw_tree + sw_vel + sw_pos;
+    StopWatch sw_total = sw_reorder + sw_merge + sw_tree + sw_acc + sw_int;
+    Log::debug("Reorder: [{}] ({})", sw_reorder, sw_reorder / sw_total);
+    if (mergers.enabled())
+        Log::debug("Merge: [{}] ({})", sw_merge, sw_merge / sw_total);
     Log::debug("Tree: [{}] ({})", sw_tree, sw_tree / sw_total);
-    Log::debug("Vel:  [{}] ({})", sw_vel, sw_vel / sw_total);
-    Log::debug("Pos:  [{}] ({})", sw_pos, sw_pos / sw_total);
+    Log::debug("Acc:  [{}] ({})", sw_acc, sw_acc / sw_total);
+    Log::debug("Int:  [{}] ({})", sw_int, sw_int / sw_total);
+    if (iteration != 0) {
+        Log::debug("{} tree: [{}] per iteration, {:.1f} force evaluations per iteration",
+                Config::Simulation::tree_builder_to_string(tree_builder), sw_tree / iteration,
+                static_cast<double>(force_evaluations) / iteration);
+        Log::debug("Interactions: {:.1f} per iteration",
+                static_cast<double>(total_interactions) / iteration);
+    }
+    if (respa_interval > 1) {
+        Log::debug("RESPA: far field every {} iterations, split scale {}", respa_interval,
+                Log::Distance::from(respa_split));
+    }
+    if (mergers.enabled()) {
+        const Mergers::Stats& merger_stats = mergers.get_stats();
+        Log::debug("Mergers: {} bodies absorbed in {} passes, {} of {} bodies left",
+                merger_stats.merges, merger_stats.passes, bodies.n, bodies.input_n);
+    }
+    if (binaries.enabled()) {
+        const Binaries::Stats& binary_stats = binaries.get_stats();
+        Log::debug("Binaries: {:.1f} regularized pairs per step",
+                binary_stats.steps != 0
+                        ? static_cast<double>(binary_stats.pairs) / binary_stats.steps
+                        : 0.0);
+        if (binaries.unconverged_drifts() > 0) {
+            Log::warning("Binaries: the Kepler solver did not converge on {} drifts",
+                    binaries.unconverged_drifts());
+        }
+    }
+    if (block_timesteps.enabled()) {
+        const BlockTimesteps::Stats& block_stats = block_timesteps.get_stats();
+        Log::debug("Block timesteps: {} sub-steps, {:.4f} of the bodies active per sub-step",
+                block_stats.substeps,
+                block_stats.substeps != 0 ? static_cast<double>(block_stats.active_bodies)
+                                                    / block_stats.substeps / bodies.n
+                                          : 0.0);
+    }
+    if (tree_refit) {
+        const Quadtree::RefitStats& refit_stats = qtree.get_refit_stats();
+        Log::debug("Tree refits: {}, rebuilds: {}, migrated bodies per refit: {:.1f}",
+                refit_stats.refits, refit_stats.rebuilds,
+                refit_stats.refits != 0
+                        ? static_cast<double>(refit_stats.migrated_bodies) / refit_stats.refits
+                        : 0.0);
+    }
+
+    log_thread_times();
+    StopWatch busy_total(StopWatch::State::PAUSED);
+    StopWatch busy_max(StopWatch::State::PAUSED);
+    for (const ThreadTimes& times : thread_times) {
+        busy_total = busy_total + times.busy;
+        if (times.busy.duration<std::chrono::nanoseconds>()
+                > busy_max.duration<std::chrono::nanoseconds>())
+            busy_max = times.busy;
+    }
+    if (busy_total.duration<std::chrono::nanoseconds>().count() != 0) {
+        Log::debug("{} scheduler: busy max/mean {:.3f}",
+                Config::Simulation::scheduler_to_string(scheduler),
+                busy_max / (busy_total / n_threads));
+    }
+    if (force_evaluations != 0) {
+        Log::debug("{} scheduler: interactions max/mean {:.3f} per force evaluation",
+                Config::Simulation::scheduler_to_string(scheduler),
+                cost_skew_sum / force_evaluations);
+    }
 }
 
-void BarnesHut::on_run() {
-    stop = false;
-    worker_stop = false;
-    master = std::thread(&BarnesHut::simulate, this);
-    for (uint32_t i = 0; i < n_threads - 1; i++) {
-        workers.emplace_back(&BarnesHut::worker_task, this, i);
+// The bodies move into the leaf order of the last tree every `reorder_interval` iterations
+void BarnesHut::before_step() {
+    if (reorder_interval != 0 && iteration != 0 && iteration % reorder_interval == 0) {
+        sw_reorder.resume();
+        reorder_bodies();
+        sw_reorder.pause();
     }
 }
 
-void BarnesHut::on_pause() {
-    stop = true;
-    master.join();
-    worker_stop = true;
-    std::ignore = sync_point.arrive();
-    for (auto& worker : workers) {
-        worker.join();
+void BarnesHut::after_step() {
+    if (mergers.enabled()) {
+        sw_merge.resume();
+        merge_bodies();
+        sw_merge.pause();
     }
-    workers.clear();
 }
 
-void BarnesHut::simulate() {
-    while (!should_stop()) {
-        // computeBoundingBox(bodies.size(), bodies.data());
+// Every thread runs the integrator stages on its share of the bodies, the force evaluations
+// between them are shared
+void BarnesHut::step(uint16_t thread_idx) {
+    if (block_timesteps.enabled()) {
+        block_step(thread_idx);
+        return;
+    }
+    if (respa_interval > 1) {
+        respa_step(thread_idx);
+        return;
+    }
+    if (binaries.enabled()) {
+        binary_step(thread_idx);
+        return;
+    }
+    const auto [begin_idx, end_idx] = thread_range(bodies.n, thread_idx);
+    if (needs_initial_forces())
+        evaluate_forces(thread_idx);
+    for (uint32_t stage = 0; stage <= integrator.stages(); stage++) {
+        integration_phase(thread_idx, [&]() {
+            integrator.advance(bodies, stage, timestep, begin_idx, end_idx);
+        });
+        if (stage < integrator.stages() && integrator.kicks_after(stage))
+            evaluate_forces(thread_idx);
+    }
+    // Every integrator ends on a kick, the tree holds the final positions
+    if (mergers.enabled()) {
+        integration_phase(thread_idx,
+                [&]() { mergers.find_captures(bodies, force_tree, begin_idx, end_idx); });
+    }
+}
 
-        sw_tree.resume();
-        qtree.build_tree(bodies);
-        sw_tree.pause();
+// Every thread starts and drifts its share of the bodies, the active bodies of a sub-step are
+// shared. The master picks them while the others wait on the barrier of the force evaluation.
+void BarnesHut::block_step(uint16_t thread_idx) {
+    const bool master = thread_idx == n_threads - 1;
+    const auto [begin_idx, end_idx] = thread_range(bodies.n, thread_idx);
+    if (needs_initial_forces()) {
+        if (master)
+            block_timesteps.activate_all();
+        evaluate_forces(thread_idx);
+    }
+    integration_phase(thread_idx,
+            [&]() { block_timesteps.start(bodies, timestep, begin_idx, end_idx); });
+    for (uint32_t substep = 0; substep < block_timesteps.substeps(); substep++) {
+        integration_phase(thread_idx,
+                [&]() { block_timesteps.drift(bodies, timestep, begin_idx, end_idx); });
+        if (master)
+            block_timesteps.collect_active(substep);
+        evaluate_forces(thread_idx);
+        const auto [begin, end] = thread_range(block_timesteps.n_active(), thread_idx);
+        integration_phase(
+                thread_idx, [&]() { block_timesteps.finish(bodies, timestep, begin, end); });
+    }
+}
 
-        sync_point.arrive_and_wait();
+// RESPA: the far field is integrated by a leapfrog of `respa_interval` iterations, with kicks from
+// the accelerations split off at its ends. In between, every iteration is a near field leapfrog
+// step, whose force evaluations skip the subtrees beyond the near field's cutoff. The master sums
+// the time of the interval, so that the closing far kick matches it if the timestep changed.
+void BarnesHut::respa_step(uint16_t thread_idx) {
+    const bool master = thread_idx == n_threads - 1;
+    const auto [begin_idx, end_idx] = thread_range(bodies.n, thread_idx);
+    const bool opening = iteration % respa_interval == 0;
+    const bool closing = (iteration + 1) % respa_interval == 0;
+    if (needs_initial_forces())
+        evaluate_forces(thread_idx, Field::SPLIT);
+    if (master) {
+        if (opening) {
+            far_opening = 0.5 * respa_interval * timestep;
+            far_span = 0.0;
+        }
+        far_span += timestep;
+    }
+    integration_phase(thread_idx, [&]() {
+        if (opening)
+            far_kick(0.5 * respa_interval * timestep, begin_idx, end_idx);
+        integrator.advance(bodies, 0, timestep, begin_idx, end_idx);
+    });
+    evaluate_forces(thread_idx, closing ? Field::SPLIT : Field::NEAR);
+    integration_phase(thread_idx, [&]() {
+        integrator.advance(bodies, 1, timestep, begin_idx, end_idx);
+        if (closing)
+            far_kick(far_span - far_opening, begin_idx, end_idx);
+    });
+}
 
-        sw_vel.resume();
-        update_velocities(master_offset, bodies.n);
-        sw_vel.pause();
+// Binaries: the pairs are found with the tree of the last force evaluation, which holds the
+// positions the step starts from. The master pairs the bodies up while the others wait on the
+// barrier, then every thread kicks and drifts its share of the unpaired bodies and of the pairs.
+void BarnesHut::binary_step(uint16_t thread_idx) {
+    const bool master = thread_idx == n_threads - 1;
+    const auto [begin_idx, end_idx] = thread_range(bodies.n, thread_idx);
+    if (needs_initial_forces())
+        evaluate_forces(thread_idx);
+    integration_phase(thread_idx,
+            [&]() { binaries.find_partners(bodies, force_tree, begin_idx, end_idx); });
+    if (master)
+        binaries.pair_up();
+    wait_for_threads(thread_idx);
+    const auto [pair_begin, pair_end] = thread_range(binaries.n_pairs(), thread_idx);
+    integration_phase(thread_idx, [&]() {
+        binaries.advance_unpaired(bodies, 0.5 * timestep, timestep, begin_idx, end_idx);
+        binaries.kick(bodies, 0.5 * timestep, pair_begin, pair_end);
+        binaries.drift(bodies, timestep, pair_begin, pair_end);
+    });
+    evaluate_forces(thread_idx);
+    integration_phase(thread_idx, [&]() {
+        binaries.advance_unpaired(bodies, 0.5 * timestep, 0.0, begin_idx, end_idx);
+        binaries.kick(bodies, 0.5 * timestep, pair_begin, pair_end);
+    });
+}
 
-        sw_pos.resume();
-        update_positions(master_offset, bodies.n);
-        sw_pos.pause();
+// The master builds the tree while the workers are parked on the barrier, unless all threads
+// build it together (Morton). Nobody claims work before the barrier is passed.
+void BarnesHut::evaluate_forces(uint16_t thread_idx, Field field) {
+    const bool master = thread_idx == n_threads - 1;
+    if (master) {
+        acc_work_counter.store(0, std::memory_order::relaxed);
+        force_evaluations++;
+        this->field = field;
+        if (!block_timesteps.all_active()) {
+            sw_tree.resume();
+            refresh_tree();
+            sw_tree.pause();
+        }
+        else if (tree_builder != Config::Simulation::TreeBuilder::MORTON) {
+            sw_tree.resume();
+            if (tree_refit)
+                qtree.refit_tree(bodies);
+            else
+                qtree.build_tree(bodies);
+            force_tree.pack(qtree);
+            if (quadrupole)
+                force_tree.compute_quadrupoles();
+            if (walk == Config::Simulation::Walk::GROUP)
+                force_tree.collect_groups(Constants::Simulation::GROUP_WALK_MAX_BODIES, groups);
+            if (scheduler == Config::Simulation::Scheduler::COST_ZONES)
+                compute_cost_zones();
+            sw_tree.pause();
+        }
+    }
 
-        sync_point.arrive_and_wait();
-        post_iteration();
+    sync_point.arrive_and_wait();
+
+    if (block_timesteps.all_active() && tree_builder == Config::Simulation::TreeBuilder::MORTON) {
+        if (master)
+            sw_tree.resume();
+        build_morton_tree(thread_idx);
+        if (master)
+            sw_tree.pause();
     }
+
+    if (master)
+        sw_acc.resume();
+    acceleration_phase(thread_idx);
+    if (master)
+        sw_acc.pause();
+    wait_for_threads(thread_idx);
+    if (master)
+        register_cost_skew();
 }
 
-void BarnesHut::worker_task(uint32_t worker_id) {
-    const uint64_t begin_idx = worker_id * worker_chunk;
-    const uint64_t end_idx = begin_idx + worker_chunk;
-    while (true) {
-        sync_point.arrive_and_wait();
-        if (worker_stop)
-            return;
-        update_velocities(begin_idx, end_idx);
-        update_positions(begin_idx, end_idx);
+// Block timesteps: between the full evaluations the tree keeps its topology and follows the
+// drifted bodies. Only the groups holding an active body are walked.
+void BarnesHut::refresh_tree() {
+    force_tree.refresh(bodies);
+    if (quadrupole)
+        force_tree.compute_quadrupoles();
+    if (walk == Config::Simulation::Walk::GROUP) {
+        active_groups.clear();
+        for (const uint32_t group_idx : groups) {
+            const ForceTree::Node& group = force_tree.nodes[group_idx];
+            for (uint32_t i = group.body_begin; i < group.body_end; i++) {
+                if (block_timesteps.is_active(force_tree.body_idxs[i])) {
+                    active_groups.push_back(group_idx);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Moves the bodies into the leaf order of the last tree, so that bodies close in space are close
+// in memory and every thread's chunk of bodies walks a compact part of the tree
+void BarnesHut::reorder_bodies() {
+    const std::vector<uint32_t>& order = force_tree.body_idxs;
+    bodies.reorder(order);
+    qtree.reorder_bodies(order);
+    std::vector<uint32_t> costs(bodies.n);
+    for (uint64_t i = 0; i < bodies.n; i++) {
+        costs[i] = body_costs[order[i]];
+    }
+    body_costs.swap(costs);
+    if (respa_interval > 1) {
+        std::vector<double> reordered(bodies.n);
+        for (uint64_t i = 0; i < bodies.n; i++) {
+            reordered[i] = far_ax[order[i]];
+        }
+        far_ax.swap(reordered);
+        for (uint64_t i = 0; i < bodies.n; i++) {
+            reordered[i] = far_ay[order[i]];
+        }
+        far_ay.swap(reordered);
+    }
+    if (block_timesteps.enabled())
+        block_timesteps.reorder(order);
+    // The tree now indexes the bodies in order, it stays valid for the refreshes
+    std::iota(force_tree.body_idxs.begin(), force_tree.body_idxs.end(), 0);
+}
+
+// The master compacts the per-body state while the workers are parked. The tree is rebuilt by the
+// next force evaluation, until then its leaf order stays usable for reordering the bodies.
+void BarnesHut::merge_bodies() {
+    if (!mergers.merge(bodies))
+        return;
+    const std::span<const uint32_t> new_idxs = mergers.get_new_indices();
+    for (uint64_t i = 0; i < new_idxs.size(); i++) {
+        if (new_idxs[i] != Mergers::NONE)
+            body_costs[new_idxs[i]] = body_costs[i];
+    }
+    body_costs.resize(bodies.n);
+    std::vector<uint32_t>& order = force_tree.body_idxs;
+    std::erase_if(order, [&](uint32_t body_idx) { return new_idxs[body_idx] == Mergers::NONE; });
+    for (uint32_t& body_idx : order) {
+        body_idx = new_idxs[body_idx];
+    }
+    if (tree_builder == Config::Simulation::TreeBuilder::MORTON)
+        morton_tree.set_body_count(bodies.n);
+}
+
+void BarnesHut::build_morton_tree(uint16_t thread_idx) {
+    morton_tree.build_tree(bodies, thread_idx, sync_point);
+    morton_tree.pack(force_tree, thread_idx, sync_point);
+    if (quadrupole || walk == Config::Simulation::Walk::GROUP
+            || scheduler == Config::Simulation::Scheduler::COST_ZONES) {
+        if (thread_idx == 0 && quadrupole)
+            force_tree.compute_quadrupoles();
+        if (thread_idx == 0 && walk == Config::Simulation::Walk::GROUP)
+            force_tree.collect_groups(Constants::Simulation::GROUP_WALK_MAX_BODIES, groups);
+        if (thread_idx == 0 && scheduler == Config::Simulation::Scheduler::COST_ZONES)
+            compute_cost_zones();
         sync_point.arrive_and_wait();
     }
 }
 
-void BarnesHut::update_positions(uint64_t begin_idx, uint64_t end_idx) {
-    for (uint64_t idx = begin_idx; idx < end_idx; idx++) {
-        bodies.pos(idx) += bodies.vel(idx) * timestep;
+// Cuts the velocity phase items, in tree order, into `n_threads` contiguous zones of about equal
+// cost. The cost of a body is the number of interactions it needed in the previous step.
+void BarnesHut::compute_cost_zones() {
+    const bool group_walk = walk == Config::Simulation::Walk::GROUP;
+    const uint64_t n_items = group_walk ? groups.size() : bodies.n;
+    item_costs.resize(n_items);
+    uint64_t total_cost = 0;
+    for (uint64_t item = 0; item < n_items; item++) {
+        if (group_walk) {
+            const ForceTree::Node& group = force_tree.nodes[groups[item]];
+            item_costs[item] = 0;
+            for (uint32_t i = group.body_begin; i < group.body_end; i++) {
+                item_costs[item] += body_costs[force_tree.body_idxs[i]];
+            }
+        }
+        else {
+            item_costs[item] = body_costs[force_tree.body_idxs[item]];
+        }
+        total_cost += item_costs[item];
+    }
+
+    uint64_t cost = 0;
+    uint16_t zone = 1;
+    zone_begin[0] = 0;
+    for (uint64_t item = 0; item < n_items && zone < n_threads; item++) {
+        while (zone < n_threads && cost >= total_cost * zone / n_threads) {
+            zone_begin[zone++] = item;
+        }
+        cost += item_costs[item];
+    }
+    while (zone <= n_threads) {
+        zone_begin[zone++] = n_items;
+    }
+}
+
+// Called by the master once every thread has finished the acceleration phase
+void BarnesHut::register_cost_skew() {
+    uint64_t total_cost = 0;
+    uint64_t max_cost = 0;
+    for (ThreadStats& stats : thread_stats) {
+        total_cost += stats.step_cost;
+        max_cost = std::max(max_cost, stats.step_cost);
+        stats.step_cost = 0;
     }
+    total_interactions += total_cost;
+    if (total_cost != 0)
+        cost_skew_sum += static_cast<double>(max_cost) * n_threads / total_cost;
 }
 
-void BarnesHut::update_velocities(uint64_t begin_idx, uint64_t end_idx) {
+std::pair<uint64_t, uint64_t> BarnesHut::thread_range(uint64_t n_items,
+        uint16_t thread_idx) const {
+    return {n_items * thread_idx / n_threads, n_items * (thread_idx + 1) / n_threads};
+}
+
+// DYNAMIC: threads claim `chunk` items at a time from the shared counter until none are left.
+// Otherwise every thread updates its own contiguous share of the items.
+template <typename F>
+void BarnesHut::schedule(std::atomic<uint64_t>& work_counter, uint64_t n_items, uint64_t chunk,
+        uint16_t thread_idx, F&& update) {
+    thread_times[thread_idx].busy.resume();
+    if (scheduler != Config::Simulation::Scheduler::DYNAMIC) {
+        const auto [begin, end] = thread_range(n_items, thread_idx);
+        update(begin, end);
+    }
+    else {
+        while (true) {
+            const uint64_t begin = work_counter.fetch_add(chunk, std::memory_order::relaxed);
+            if (begin >= n_items)
+                break;
+            update(begin, std::min(begin + chunk, n_items));
+        }
+    }
+    thread_times[thread_idx].busy.pause();
+}
+
+// Cost zones only apply to the acceleration phase, the integrator stages cost the same for every
+// body. They cover every item, so the items of a partial (block timestep) evaluation are split
+// evenly instead, unless they are scheduled dynamically.
+void BarnesHut::acceleration_phase(uint16_t thread_idx) {
+    using namespace Constants::Simulation;
+    uint64_t& step_cost = thread_stats[thread_idx].step_cost;
+    if (!block_timesteps.all_active()) {
+        if (walk == Config::Simulation::Walk::GROUP) {
+            schedule(acc_work_counter, active_groups.size(),
+                    std::max(DYNAMIC_CHUNK_BODIES / GROUP_WALK_MAX_BODIES, 1u), thread_idx,
+                    [this, thread_idx, &step_cost](uint64_t begin, uint64_t end) {
+                        for (uint64_t g = begin; g < end; g++) {
+                            step_cost += update_group_acceleration(active_groups[g],
+                                    interaction_lists[thread_idx], far_lists[thread_idx]);
+                        }
+                    });
+        }
+        else {
+            const std::span<const uint32_t> active = block_timesteps.active_bodies();
+            schedule(acc_work_counter, active.size(), DYNAMIC_CHUNK_BODIES, thread_idx,
+                    [this, active, &step_cost](uint64_t begin, uint64_t end) {
+                        for (uint64_t i = begin; i < end; i++) {
+                            step_cost += update_acceleration(active[i]);
+                        }
+                    });
+        }
+    }
+    else if (scheduler == Config::Simulation::Scheduler::COST_ZONES) {
+        thread_times[thread_idx].busy.resume();
+        const uint64_t begin = zone_begin[thread_idx];
+        const uint64_t end = zone_begin[thread_idx + 1];
+        if (walk == Config::Simulation::Walk::GROUP) {
+            step_cost += update_group_accelerations(
+                    begin, end, interaction_lists[thread_idx], far_lists[thread_idx]);
+        }
+        else {
+            for (uint64_t i = begin; i < end; i++) {
+                step_cost += update_acceleration(force_tree.body_idxs[i]);
+            }
+        }
+        thread_times[thread_idx].busy.pause();
+    }
+    else if (walk == Config::Simulation::Walk::GROUP) {
+        schedule(acc_work_counter, groups.size(),
+                std::max(DYNAMIC_CHUNK_BODIES / GROUP_WALK_MAX_BODIES, 1u), thread_idx,
+                [this, thread_idx, &step_cost](uint64_t begin, uint64_t end) {
+                    step_cost += update_group_accelerations(
+                            begin, end, interaction_lists[thread_idx], far_lists[thread_idx]);
+                });
+    }
+    else {
+        schedule(acc_work_counter, bodies.n, DYNAMIC_CHUNK_BODIES, thread_idx,
+                [this, &step_cost](uint64_t begin, uint64_t end) {
+                    step_cost += update_accelerations(begin, end);
+                });
+    }
+}
+
+// The stages are cheap and uniform, every thread updates its own contiguous share of the bodies
+template <typename F>
+void BarnesHut::integration_phase(uint16_t thread_idx, F&& update) {
+    const bool master = thread_idx == n_threads - 1;
+    if (master)
+        sw_int.resume();
+    thread_times[thread_idx].busy.resume();
+    update();
+    thread_times[thread_idx].busy.pause();
+    if (master)
+        sw_int.pause();
+    wait_for_threads(thread_idx);
+}
+
+void BarnesHut::far_kick(double timestep, uint64_t begin_idx, uint64_t end_idx) {
+    double* __restrict vx = bodies.vx().data();
+    double* __restrict vy = bodies.vy().data();
+    const double* __restrict ax = far_ax.data();
+    const double* __restrict ay = far_ay.data();
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        vx[i] += ax[i] * timestep;
+        vy[i] += ay[i] * timestep;
+    }
+}
+
+// RESPA: share of an interaction at the squared softened distance `soft_sq` that is near field.
+// The erfc split is shifted and rescaled to reach zero at the cutoff, where the near walk stops.
+// The far share is the rest, so that near and far always sum to the full force of the interaction.
+// Inlined, so that the pair loops vectorize.
+inline double BarnesHut::near_share(double soft_sq) const {
+    const double g = erfc_split(std::sqrt(soft_sq) / (2.0 * respa_split));
+    return std::max((g - respa_cutoff_share) / (1.0 - respa_cutoff_share), 0.0);
+}
+
+uint64_t BarnesHut::update_accelerations(uint64_t begin_idx, uint64_t end_idx) {
+    uint64_t cost = 0;
     for (uint64_t idx = begin_idx; idx < end_idx; idx++) {
-        update_velocity(idx);
+        cost += update_acceleration(idx);
     }
+    return cost;
 }
 
-// iterative DFS
-void BarnesHut::update_velocity(uint64_t body_idx) {
-    std::vector<uint32_t> quad_idx_stack;
-    quad_idx_stack.reserve(2000);
-    quad_idx_stack.push_back(0);
+// iterative DFS over the packed tree, leaves may hold up to `leaf_size` bodies. Returns the number
+// of interactions.
+uint32_t BarnesHut::update_acceleration(uint64_t body_idx) {
+    const std::vector<ForceTree::Node>& nodes = force_tree.nodes;
+    const sf::Vector2<double> pos = bodies.pos(body_idx);
+    const double mass = bodies.mass(body_idx);
 
     sf::Vector2<double> F = {0.0, 0.0};
+    sf::Vector2<double> F_far = {0.0, 0.0};
+    uint32_t interactions = 0;
 
-    while (!quad_idx_stack.empty()) {
-        const Quad& quad = qtree.quads[quad_idx_stack.back()];
-        quad_idx_stack.pop_back();
-        if (quad.is_leaf()) {
-            if (quad.total_mass != 0 && quad.center_of_mass != bodies.pos(body_idx)) {
-                F += body_to_quad_force(body_idx, quad);
+    // Stackless pre-order walk: descending follows first_child, while accepting a node or
+    // finishing a leaf skips its subtree through next. RESPA splits every interaction by its own
+    // distance, the near walk skips the subtrees without a near share. Binaries: the nodes that
+    // may hold a partner are opened.
+    uint32_t node_idx = 0;
+    while (node_idx != ForceTree::END) {
+        const ForceTree::Node& node = nodes[node_idx];
+        const sf::Vector2<double> com = {node.com_x, node.com_y};
+        const double dist_squared = (pos - com).lengthSquared();
+        if (field == Field::NEAR && beyond_split(node, dist_squared)) {
+            node_idx = node.next;
+            continue;
+        }
+        if (node.is_leaf()) {
+            if (field == Field::ALL)
+                F += leaf_force(node, pos, mass);
+            else
+                split_leaf_force(node, pos, mass, F, F_far);
+            interactions += node.body_end - node.body_begin;
+            node_idx = node.next;
+            continue;
+        }
+        if (node.width_sq / dist_squared < theta_sq
+                && !(binaries.enabled() && binaries.may_hold_partner(node, dist_squared))) {
+            sf::Vector2<double> node_force = force(pos, com, mass, node.mass);
+            if (quadrupole) {
+                node_force += Constants::Simulation::G * mass
+                              * force_tree.quadrupoles[node_idx].acceleration(
+                                      pos.x - node.com_x, pos.y - node.com_y, epsilon_squared);
             }
+            if (field == Field::ALL) {
+                F += node_force;
+            }
+            else {
+                const double share = near_share(dist_squared + epsilon_squared);
+                F += share * node_force;
+                F_far += (1.0 - share) * node_force;
+            }
+            interactions++;
+            node_idx = node.next;
         }
         else {
-            const double dist_squared =
-                    (bodies.pos(body_idx) - quad.center_of_mass).lengthSquared();
-            if (quad.boundaries.size.lengthSquared() / dist_squared < theta_sq) {
-                F += body_to_quad_force(body_idx, quad);
+            node_idx = node.first_child;
+        }
+    }
+
+    bodies.ax()[body_idx] = F.x / mass;
+    bodies.ay()[body_idx] = F.y / mass;
+    if (field == Field::SPLIT) {
+        far_ax[body_idx] = F_far.x / mass;
+        far_ay[body_idx] = F_far.y / mass;
+    }
+    body_costs[body_idx] = interactions;
+    return interactions;
+}
+
+uint64_t BarnesHut::update_group_accelerations(uint64_t group_begin, uint64_t group_end,
+        InteractionList& list, InteractionList& far_list) {
+    uint64_t cost = 0;
+    for (uint64_t g = group_begin; g < group_end; g++) {
+        cost += update_group_acceleration(groups[g], list, far_list);
+    }
+    return cost;
+}
+
+// One walk for all bodies of the group. A node is accepted if the opening criterion holds for the
+// point of the group's bounding box closest to its COM, and so for every body of the group.
+// Binaries: a node that may hold a partner of any body of the group, measured from the same point,
+// is opened. The shared list is then summed directly for each body. RESPA splits every pair of the
+// list by its own distance, except for the interactions beyond the cutoff from the whole group,
+// which are far field only. The split evaluation sums those with the gravity kernel, from the far
+// list. Returns the number of interactions.
+uint64_t BarnesHut::update_group_acceleration(uint32_t group_idx, InteractionList& list,
+        InteractionList& far_list) {
+    const std::vector<ForceTree::Node>& nodes = force_tree.nodes;
+    const ForceTree::Node& group = nodes[group_idx];
+    const double* x = force_tree.body_x.data();
+    const double* y = force_tree.body_y.data();
+    const double* m = force_tree.body_mass.data();
+
+    double x_min = x[group.body_begin], x_max = x_min;
+    double y_min = y[group.body_begin], y_max = y_min;
+    for (uint32_t i = group.body_begin + 1; i < group.body_end; i++) {
+        x_min = std::min(x_min, x[i]);
+        x_max = std::max(x_max, x[i]);
+        y_min = std::min(y_min, y[i]);
+        y_max = std::max(y_max, y[i]);
+    }
+
+    // Squared distance from the closest point of the group's bounding box
+    const auto box_distance_sq = [=](double px, double py) {
+        const double dx = std::max({x_min - px, px - x_max, 0.0});
+        const double dy = std::max({y_min - py, py - y_max, 0.0});
+        return dx * dx + dy * dy;
+    };
+    // RESPA: an interaction beyond the cutoff from the whole group has no near share, the near
+    // evaluation drops it
+    InteractionList* const far_target = field == Field::SPLIT ? &far_list : nullptr;
+
+    list.clear();
+    far_list.clear();
+    uint32_t node_idx = 0;
+    while (node_idx != ForceTree::END) {
+        const ForceTree::Node& node = nodes[node_idx];
+        const double dist_squared = box_distance_sq(node.com_x, node.com_y);
+        if (field == Field::NEAR && beyond_split(node, dist_squared)) {
+            node_idx = node.next;
+            continue;
+        }
+        if (node.is_leaf()) {
+            for (uint32_t i = node.body_begin; i < node.body_end; i++) {
+                const bool far = field != Field::ALL
+                                 && box_distance_sq(x[i], y[i]) >= respa_cutoff_sq;
+                InteractionList* target = far ? far_target : &list;
+                if (target)
+                    target->push_back(x[i], y[i], m[i]);
             }
-            else {
-                quad_idx_stack.push_back(quad.top_left_idx + 3);
-                quad_idx_stack.push_back(quad.top_left_idx + 2);
-                quad_idx_stack.push_back(quad.top_left_idx + 1);
-                quad_idx_stack.push_back(quad.top_left_idx);
+            node_idx = node.next;
+            continue;
+        }
+        if (node.width_sq < theta_sq * dist_squared
+                && !(binaries.enabled() && binaries.may_hold_partner(node, dist_squared))) {
+            const bool far = field != Field::ALL && dist_squared >= respa_cutoff_sq;
+            InteractionList* target = far ? far_target : &list;
+            if (target) {
+                target->push_back(node.com_x, node.com_y, node.mass);
+                if (quadrupole)
+                    target->accepted_nodes.push_back(node_idx);
             }
+            node_idx = node.next;
+        }
+        else {
+            node_idx = node.first_child;
         }
     }
 
-    bodies.vel(body_idx) += F / bodies.mass(body_idx) * timestep;
+    const uint32_t list_size = list.x.size() + far_list.x.size();
+    if (field == Field::ALL)
+        sum_interactions(group, list);
+    else
+        sum_split_interactions(group, list);
+    if (field == Field::SPLIT)
+        sum_interactions(group, far_list);
+    for (uint32_t i = 0; i < group.body_end - group.body_begin; i++) {
+        const uint32_t body_idx = force_tree.body_idxs[group.body_begin + i];
+        bodies.ax()[body_idx] = Constants::Simulation::G * list.ax[i];
+        bodies.ay()[body_idx] = Constants::Simulation::G * list.ay[i];
+        if (field == Field::SPLIT) {
+            far_ax[body_idx] = Constants::Simulation::G * (list.far_ax[i] + far_list.ax[i]);
+            far_ay[body_idx] = Constants::Simulation::G * (list.far_ay[i] + far_list.ay[i]);
+        }
+        body_costs[body_idx] = list_size;
+    }
+    return static_cast<uint64_t>(list_size) * (group.body_end - group.body_begin);
+}
+
+// The group's bodies are contiguous in the ForceTree slices, so they form the target tile of the
+// list's accelerations (without G)
+void BarnesHut::sum_interactions(const ForceTree::Node& group, InteractionList& list) const {
+    const double* x = force_tree.body_x.data();
+    const double* y = force_tree.body_y.data();
+    const uint32_t group_size = group.body_end - group.body_begin;
+    list.ax.assign(group_size, 0.0);
+    list.ay.assign(group_size, 0.0);
+    Gravity::accelerations(x + group.body_begin, y + group.body_begin, group_size,
+            {list.x.data(), list.y.data(), list.mass.data(), static_cast<uint32_t>(list.x.size())},
+            epsilon_squared, list.ax.data(), list.ay.data());
+    for (const uint32_t node_idx : list.accepted_nodes) {
+        const ForceTree::Node& node = force_tree.nodes[node_idx];
+        const ForceTree::Quadrupole& q = force_tree.quadrupoles[node_idx];
+        for (uint32_t i = 0; i < group_size; i++) {
+            const sf::Vector2<double> acc = q.acceleration(x[group.body_begin + i] - node.com_x,
+                    y[group.body_begin + i] - node.com_y, epsilon_squared);
+            list.ax[i] += acc.x;
+            list.ay[i] += acc.y;
+        }
+    }
+}
+
+// RESPA: the near share of every pair depends on its distance, so the list is summed pair by pair
+// instead of by the gravity kernel. The near accelerations (without G) go to ax, ay and the far
+// ones to far_ax, far_ay.
+void BarnesHut::sum_split_interactions(const ForceTree::Node& group,
+        InteractionList& list) const {
+    const double* x = force_tree.body_x.data();
+    const double* y = force_tree.body_y.data();
+    const double* __restrict list_x = list.x.data();
+    const double* __restrict list_y = list.y.data();
+    const double* __restrict list_mass = list.mass.data();
+    const uint32_t group_size = group.body_end - group.body_begin;
+    const uint32_t list_size = list.x.size();
+    list.ax.resize(group_size);
+    list.ay.resize(group_size);
+    list.far_ax.resize(group_size);
+    list.far_ay.resize(group_size);
+    for (uint32_t i = 0; i < group_size; i++) {
+        const double xi = x[group.body_begin + i];
+        const double yi = y[group.body_begin + i];
+        double ax = 0.0;
+        double ay = 0.0;
+        double far_ax = 0.0;
+        double far_ay = 0.0;
+        for (uint32_t j = 0; j < list_size; j++) {
+            const double dx = list_x[j] - xi;
+            const double dy = list_y[j] - yi;
+            const double dist_sq = dx * dx + dy * dy;
+            const double soft_sq = dist_sq + epsilon_squared;
+            // Zero for a source at the body's position, like the gravity kernel
+            const double f = dist_sq > 0.0 ? list_mass[j] / (soft_sq * std::sqrt(soft_sq)) : 0.0;
+            const double near_f = near_share(soft_sq) * f;
+            ax += near_f * dx;
+            ay += near_f * dy;
+            far_ax += (f - near_f) * dx;
+            far_ay += (f - near_f) * dy;
+        }
+        for (const uint32_t node_idx : list.accepted_nodes) {
+            const ForceTree::Node& node = force_tree.nodes[node_idx];
+            const double rx = xi - node.com_x;
+            const double ry = yi - node.com_y;
+            const sf::Vector2<double> acc =
+                    force_tree.quadrupoles[node_idx].acceleration(rx, ry, epsilon_squared);
+            const double share = near_share(rx * rx + ry * ry + epsilon_squared);
+            ax += share * acc.x;
+            ay += share * acc.y;
+            far_ax += (1.0 - share) * acc.x;
+            far_ay += (1.0 - share) * acc.y;
+        }
+        list.ax[i] = ax;
+        list.ay[i] = ay;
+        list.far_ax[i] = far_ax;
+        list.far_ay[i] = far_ay;
+    }
+}
+
+// RESPA: whether the whole subtree of `node` lies beyond the near field's cutoff. Its bodies, and
+// so the COMs below it, are within a diagonal of the node's COM.
+bool BarnesHut::beyond_split(const ForceTree::Node& node, double dist_squared) const {
+    const double reach = std::sqrt(respa_cutoff_sq) + std::sqrt(node.width_sq);
+    return dist_squared > reach * reach;
+}
+
+sf::Vector2<double> BarnesHut::leaf_force(const ForceTree::Node& leaf,
+        const sf::Vector2<double>& pos, double mass) const {
+    const Gravity::Sources sources = {force_tree.body_x.data() + leaf.body_begin,
+            force_tree.body_y.data() + leaf.body_begin,
+            force_tree.body_mass.data() + leaf.body_begin, leaf.body_end - leaf.body_begin};
+    sf::Vector2<double> acc = {0.0, 0.0};
+    Gravity::accelerations(&pos.x, &pos.y, 1, sources, epsilon_squared, &acc.x, &acc.y);
+    return Constants::Simulation::G * mass * acc;
 }
 
-sf::Vector2<double> BarnesHut::body_to_quad_force(uint64_t body_idx, const Quad& quad) {
-    const double dist = distance(bodies.pos(body_idx), quad.center_of_mass);
-    const double force_amplitude = Constants::Simulation::G * bodies.mass(body_idx)
-                                   * quad.total_mass / (dist * dist + epsilon_squared);
-    return ((quad.center_of_mass - bodies.pos(body_idx)) / dist) * force_amplitude;
+// RESPA: the leaf's bodies split one by one into the near and the far force
+void BarnesHut::split_leaf_force(const ForceTree::Node& leaf, const sf::Vector2<double>& pos,
+        double mass, sf::Vector2<double>& F, sf::Vector2<double>& F_far) const {
+    for (uint32_t i = leaf.body_begin; i < leaf.body_end; i++) {
+        const sf::Vector2<double> source = {force_tree.body_x[i], force_tree.body_y[i]};
+        const double dist_squared = (source - pos).lengthSquared();
+        if (dist_squared == 0.0)
+            continue;
+        const sf::Vector2<double> f = force(pos, source, mass, force_tree.body_mass[i]);
+        const double share = near_share(dist_squared + epsilon_squared);
+        F += share * f;
+        F_far += (1.0 - share) * f;
+    }
 }
@@ -5,26 +5,24 @@
 
 
 BarnesHutCuda::BarnesHutCuda(const Config::Simulation& sim_cfg, Bodies& bodies)
-        : Simulation(sim_cfg, bodies), theta_sq(sim_cfg.theta * sim_cfg.theta),
+        : Simulation(sim_cfg, bodies, 1), theta_sq(sim_cfg.theta * sim_cfg.theta),
           max_quads(static_cast<int32_t>(bodies.n) * 5) {
     init_device_resources();
 }
 
 BarnesHutCuda::~BarnesHutCuda() {
-    if (sim_thread.joinable()) {
-        on_pause();
-    }
+    on_pause();
     release_device_resources();
 }
 
 void BarnesHutCuda::on_run() {
     stop = false;
-    sim_thread = std::thread(&BarnesHutCuda::simulate, this);
+    thread_pool.launch([this](uint16_t) { simulate(); }, 1);
 }
 
 void BarnesHutCuda::on_pause() {
     stop = true;
-    sim_thread.join();
+    thread_pool.wait();
 }
 
 void BarnesHutCuda::simulate() {
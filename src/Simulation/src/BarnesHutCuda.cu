@@ -495,13 +495,17 @@ __global__ void update_positions(Vector2* pos, const Vector2* vel, int32_t n, do
 }
 
 // ---- Scatter sorted data back to original body order ----
+// The output is SoA, matching the host `Bodies` columns
 __global__ void scatter_to_original_order(const Vector2* sorted_pos, const Vector2* sorted_vel,
-        const int32_t* idx, Vector2* out_pos, Vector2* out_vel, int32_t n) {
+        const int32_t* idx, double* out_x, double* out_y, double* out_vx, double* out_vy,
+        int32_t n) {
     const int32_t i = static_cast<int32_t>(blockIdx.x * blockDim.x + threadIdx.x);
     if (i < n) {
         const int32_t orig = idx[i];
-        out_pos[orig] = sorted_pos[i];
-        out_vel[orig] = sorted_vel[i];
+        out_x[orig] = sorted_pos[i].x;
+        out_y[orig] = sorted_pos[i].y;
+        out_vx[orig] = sorted_vel[i].x;
+        out_vy[orig] = sorted_vel[i].y;
     }
 }
 
@@ -595,8 +599,15 @@ void BarnesHutCuda::init_device_resources() {
 
     // Upload initial body data
     CUDA_CHECK(cudaMemcpy(mass_d, bodies.mass_data(), mass_bytes, cudaMemcpyHostToDevice));
-    CUDA_CHECK(cudaMemcpy(pos_d, bodies.pos_data(), pos_bytes, cudaMemcpyHostToDevice));
-    CUDA_CHECK(cudaMemcpy(vel_d, bodies.vel_data(), vel_bytes, cudaMemcpyHostToDevice));
+    // The host columns are interleaved into the device Vector2 arrays by strided copies
+    const auto upload_column = [n](Vector2* dst_d, size_t component, const double* src) {
+        CUDA_CHECK(cudaMemcpy2D(reinterpret_cast<double*>(dst_d) + component, sizeof(Vector2), src,
+                sizeof(double), sizeof(double), n, cudaMemcpyHostToDevice));
+    };
+    upload_column(pos_d, 0, bodies.x().data());
+    upload_column(pos_d, 1, bodies.y().data());
+    upload_column(vel_d, 0, bodies.vx().data());
+    upload_column(vel_d, 1, bodies.vy().data());
 
     // Initialize index to identity
     const uint32_t grid = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
@@ -633,16 +644,20 @@ void BarnesHutCuda::sync_from_gpu_bodies() {
     const int32_t n = static_cast<int32_t>(bodies.n);
     const uint32_t grid = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
 
-    // Scatter sorted GPU data back to original body order
-    Kernel::scatter_to_original_order<<<grid, BLOCK_SIZE>>>(pos_d, vel_d, idx_d, pos_alt_d,
-            vel_alt_d, n);
+    // Scatter sorted GPU data back to original body order, as x|y and vx|vy columns in the
+    // alternate buffers
+    double* x_d = reinterpret_cast<double*>(pos_alt_d);
+    double* vx_d = reinterpret_cast<double*>(vel_alt_d);
+    Kernel::scatter_to_original_order<<<grid, BLOCK_SIZE>>>(pos_d, vel_d, idx_d, x_d, x_d + n,
+            vx_d, vx_d + n, n);
     CUDA_CHECK(cudaGetLastError());
     CUDA_CHECK(cudaDeviceSynchronize());
 
-    CUDA_CHECK(
-            cudaMemcpy(bodies.pos_data(), pos_alt_d, sizeof(Vector2) * n, cudaMemcpyDeviceToHost));
-    CUDA_CHECK(
-            cudaMemcpy(bodies.vel_data(), vel_alt_d, sizeof(Vector2) * n, cudaMemcpyDeviceToHost));
+    const size_t column_bytes = sizeof(double) * n;
+    CUDA_CHECK(cudaMemcpy(bodies.x().data(), x_d, column_bytes, cudaMemcpyDeviceToHost));
+    CUDA_CHECK(cudaMemcpy(bodies.y().data(), x_d + n, column_bytes, cudaMemcpyDeviceToHost));
+    CUDA_CHECK(cudaMemcpy(bodies.vx().data(), vx_d, column_bytes, cudaMemcpyDeviceToHost));
+    CUDA_CHECK(cudaMemcpy(bodies.vy().data(), vx_d + n, column_bytes, cudaMemcpyDeviceToHost));
 }
 
 void BarnesHutCuda::compute_bounding_box() {
@@ -0,0 +1,167 @@
+#include "Simulation/Binaries.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Constants/Constants.hpp"
+#include "Simulation/Kepler.hpp"
+
+
+Binaries::Binaries(const Config::Simulation& sim_cfg, double epsilon_squared, uint64_t n_bodies)
+        : radius_sq(sim_cfg.binary_radius * sim_cfg.binary_radius),
+          epsilon_squared(epsilon_squared), nearest(radius_sq != 0.0 ? n_bodies : 0, NONE),
+          partners(nearest.size(), NONE) {}
+
+bool Binaries::enabled() const {
+    return radius_sq != 0.0;
+}
+
+// Bound means a negative (unsoftened) two-body energy. The apocenter a (1 + e) must lie within
+// the radius too, so that the pair stays within it during the step.
+void Binaries::find_partners(const Bodies& bodies, const ForceTree& tree, uint64_t begin_idx,
+        uint64_t end_idx) {
+    const std::span<const double> px = bodies.x();
+    const std::span<const double> py = bodies.y();
+    const std::span<const double> vx = bodies.vx();
+    const std::span<const double> vy = bodies.vy();
+    const std::span<const double> m = bodies.masses();
+    const double radius = std::sqrt(radius_sq);
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        const double x = px[i];
+        const double y = py[i];
+        uint32_t best = NONE;
+        double best_dist_sq = radius_sq;
+        tree.visit_bodies_near(x, y, radius, [&](uint32_t k) {
+            const uint32_t j = tree.body_idxs[k];
+            const double rx = tree.body_x[k] - x;
+            const double ry = tree.body_y[k] - y;
+            const double dist_sq = rx * rx + ry * ry;
+            if (j == i || dist_sq >= best_dist_sq || dist_sq == 0.0)
+                return;
+            const double ux = vx[j] - vx[i];
+            const double uy = vy[j] - vy[i];
+            const double mu = Constants::Simulation::G * (m[i] + m[j]);
+            const double energy = 0.5 * (ux * ux + uy * uy) - mu / std::sqrt(dist_sq);
+            if (energy >= 0.0)
+                return;
+            const double h = rx * uy - ry * ux;
+            const double e = std::sqrt(std::max(1.0 + 2.0 * energy * h * h / (mu * mu), 0.0));
+            if (-mu / (2.0 * energy) * (1.0 + e) < radius) {
+                best = j;
+                best_dist_sq = dist_sq;
+            }
+        });
+        nearest[i] = best;
+    }
+}
+
+void Binaries::pair_up() {
+    pairs.clear();
+    for (uint32_t i = 0; i < nearest.size(); i++) {
+        const uint32_t j = nearest[i];
+        partners[i] = j != NONE && nearest[j] == i ? j : NONE;
+        if (partners[i] != NONE && i < j)
+            pairs.emplace_back(i, j);
+    }
+    stats.steps++;
+    stats.pairs += pairs.size();
+}
+
+bool Binaries::is_paired(uint64_t body_idx) const {
+    return partners[body_idx] != NONE;
+}
+
+// The bodies of a node lie within its diagonal from its COM, like for ForceTree::visit_bodies_near
+bool Binaries::may_hold_partner(const ForceTree::Node& node, double dist_squared) const {
+    const double reach = std::sqrt(radius_sq) + std::sqrt(node.width_sq);
+    return dist_squared <= reach * reach;
+}
+
+uint64_t Binaries::n_pairs() const {
+    return pairs.size();
+}
+
+// The engines' accelerations of a member hold the softened force of the other one
+void Binaries::kick(Bodies& bodies, double timestep, uint64_t pair_begin,
+        uint64_t pair_end) const {
+    const std::span<const double> x = bodies.x();
+    const std::span<const double> y = bodies.y();
+    const std::span<double> vx = bodies.vx();
+    const std::span<double> vy = bodies.vy();
+    const std::span<const double> ax = bodies.ax();
+    const std::span<const double> ay = bodies.ay();
+    const std::span<const double> m = bodies.masses();
+    for (uint64_t p = pair_begin; p < pair_end; p++) {
+        const auto [i, j] = pairs[p];
+        const double rx = x[j] - x[i];
+        const double ry = y[j] - y[i];
+        const double r_sq = rx * rx + ry * ry + epsilon_squared;
+        const double inv_r3 = Constants::Simulation::G / (r_sq * std::sqrt(r_sq));
+        vx[i] += (ax[i] - m[j] * inv_r3 * rx) * timestep;
+        vy[i] += (ay[i] - m[j] * inv_r3 * ry) * timestep;
+        vx[j] += (ax[j] + m[i] * inv_r3 * rx) * timestep;
+        vy[j] += (ay[j] + m[i] * inv_r3 * ry) * timestep;
+    }
+}
+
+void Binaries::drift(Bodies& bodies, double timestep, uint64_t pair_begin,
+        uint64_t pair_end) const {
+    const std::span<double> x = bodies.x();
+    const std::span<double> y = bodies.y();
+    const std::span<double> vx = bodies.vx();
+    const std::span<double> vy = bodies.vy();
+    const std::span<const double> m = bodies.masses();
+    uint64_t unconverged = 0;
+    for (uint64_t p = pair_begin; p < pair_end; p++) {
+        const auto [i, j] = pairs[p];
+        const double mass = m[i] + m[j];
+        const double wi = m[i] / mass;
+        const double wj = m[j] / mass;
+        const double com_vx = wi * vx[i] + wj * vx[j];
+        const double com_vy = wi * vy[i] + wj * vy[j];
+        const double com_x = wi * x[i] + wj * x[j] + com_vx * timestep;
+        const double com_y = wi * y[i] + wj * y[j] + com_vy * timestep;
+        double rx = x[j] - x[i];
+        double ry = y[j] - y[i];
+        double ux = vx[j] - vx[i];
+        double uy = vy[j] - vy[i];
+        if (!Kepler::drift(Constants::Simulation::G * mass, timestep, rx, ry, ux, uy))
+            unconverged++;
+        x[i] = com_x - wj * rx;
+        y[i] = com_y - wj * ry;
+        x[j] = com_x + wi * rx;
+        y[j] = com_y + wi * ry;
+        vx[i] = com_vx - wj * ux;
+        vy[i] = com_vy - wj * uy;
+        vx[j] = com_vx + wi * ux;
+        vy[j] = com_vy + wi * uy;
+    }
+    if (unconverged > 0)
+        n_unconverged_drifts.fetch_add(unconverged, std::memory_order::relaxed);
+}
+
+void Binaries::advance_unpaired(Bodies& bodies, double kick, double drift, uint64_t begin_idx,
+        uint64_t end_idx) const {
+    double* __restrict x = bodies.x().data();
+    double* __restrict y = bodies.y().data();
+    double* __restrict vx = bodies.vx().data();
+    double* __restrict vy = bodies.vy().data();
+    const double* __restrict ax = bodies.ax().data();
+    const double* __restrict ay = bodies.ay().data();
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        if (partners[i] != NONE)
+            continue;
+        vx[i] += ax[i] * kick;
+        vy[i] += ay[i] * kick;
+        x[i] += vx[i] * drift;
+        y[i] += vy[i] * drift;
+    }
+}
+
+const Binaries::Stats& Binaries::get_stats() const {
+    return stats;
+}
+
+uint64_t Binaries::unconverged_drifts() const {
+    return n_unconverged_drifts.load(std::memory_order::relaxed);
+}
@@ -0,0 +1,131 @@
+#include "Simulation/BlockTimesteps.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+
+
+BlockTimesteps::BlockTimesteps(const Config::Simulation& sim_cfg, double epsilon,
+        uint64_t n_bodies)
+        : max_level(sim_cfg.block_levels), eta(sim_cfg.block_eta), epsilon(epsilon),
+          levels(max_level != 0 ? n_bodies : 0, 0) {
+    assert(max_level < 8 * sizeof(uint32_t));
+}
+
+bool BlockTimesteps::enabled() const {
+    return max_level != 0;
+}
+
+uint32_t BlockTimesteps::substeps() const {
+    return 1u << max_level;
+}
+
+void BlockTimesteps::start(Bodies& bodies, double timestep, uint64_t begin_idx,
+        uint64_t end_idx) {
+    double* __restrict vx = bodies.vx().data();
+    double* __restrict vy = bodies.vy().data();
+    const double* __restrict ax = bodies.ax().data();
+    const double* __restrict ay = bodies.ay().data();
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        levels[i] = pick_level(ax[i], ay[i], timestep);
+        const double half_step = 0.5 * std::ldexp(timestep, -levels[i]);
+        vx[i] += ax[i] * half_step;
+        vy[i] += ay[i] * half_step;
+    }
+}
+
+void BlockTimesteps::drift(Bodies& bodies, double timestep, uint64_t begin_idx,
+        uint64_t end_idx) const {
+    double* __restrict x = bodies.x().data();
+    double* __restrict y = bodies.y().data();
+    const double* __restrict vx = bodies.vx().data();
+    const double* __restrict vy = bodies.vy().data();
+    const double dt = std::ldexp(timestep, -static_cast<int>(max_level));
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+    }
+}
+
+// A level k step ends with the sub-step when the sub-steps done are a multiple of 2^(max - k)
+void BlockTimesteps::collect_active(uint32_t substep) {
+    this->substep = substep;
+    all = substep + 1 == substeps();
+    active.clear();
+    if (!all) {
+        for (uint32_t i = 0; i < levels.size(); i++) {
+            if (is_active(i))
+                active.push_back(i);
+        }
+    }
+    stats.substeps++;
+    stats.active_bodies += n_active();
+}
+
+void BlockTimesteps::activate_all() {
+    substep = substeps() - 1;
+    all = true;
+    active.clear();
+}
+
+bool BlockTimesteps::all_active() const {
+    return all;
+}
+
+bool BlockTimesteps::is_active(uint64_t body_idx) const {
+    return all || (substep + 1) % (1u << (max_level - levels[body_idx])) == 0;
+}
+
+uint64_t BlockTimesteps::n_active() const {
+    return all ? levels.size() : active.size();
+}
+
+std::span<const uint32_t> BlockTimesteps::active_bodies() const {
+    return active;
+}
+
+// A body may only move to a level whose steps start at this sub-step: 2^(max - level) must
+// divide the sub-steps done, which bounds the level from below. The iteration's last sub-step
+// only closes, the next iteration starts every body over.
+void BlockTimesteps::finish(Bodies& bodies, double timestep, uint64_t begin, uint64_t end) {
+    const std::span<double> vx = bodies.vx();
+    const std::span<double> vy = bodies.vy();
+    const std::span<const double> ax = bodies.ax();
+    const std::span<const double> ay = bodies.ay();
+    const bool last = substep + 1 == substeps();
+    const uint8_t min_level = last ? 0 : max_level - std::countr_zero(substep + 1);
+    for (uint64_t item = begin; item < end; item++) {
+        const uint32_t i = all ? item : active[item];
+        double half_step = 0.5 * std::ldexp(timestep, -levels[i]);
+        if (!last) {
+            levels[i] = std::max(pick_level(ax[i], ay[i], timestep), min_level);
+            half_step += 0.5 * std::ldexp(timestep, -levels[i]);
+        }
+        vx[i] += ax[i] * half_step;
+        vy[i] += ay[i] * half_step;
+    }
+}
+
+void BlockTimesteps::reorder(std::span<const uint32_t> order) {
+    std::vector<uint8_t> reordered(levels.size());
+    for (uint64_t i = 0; i < levels.size(); i++) {
+        reordered[i] = levels[order[i]];
+    }
+    levels.swap(reordered);
+}
+
+const BlockTimesteps::Stats& BlockTimesteps::get_stats() const {
+    return stats;
+}
+
+// The coarsest level whose step is within the criterion's
+uint8_t BlockTimesteps::pick_level(double ax, double ay, double timestep) const {
+    const double acc = std::sqrt(ax * ax + ay * ay);
+    if (acc == 0.0)
+        return 0;
+    const double dt = std::sqrt(2.0 * eta * epsilon / acc);
+    if (dt >= timestep)
+        return 0;
+    return std::min(static_cast<uint32_t>(std::ceil(std::log2(timestep / dt))), max_level);
+}
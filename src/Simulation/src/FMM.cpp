@@ -0,0 +1,390 @@
+#include "Simulation/FMM.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "GravityKernel/GravityKernel.hpp"
+#include "Logger/Logger.hpp"
+
+
+using Powers = std::array<double, Constants::Simulation::FMM_ORDER_RANGE.second + 1>;
+
+// base^i / i! for i = 0, ..., order
+static void fill_scaled_powers(Powers& powers, double base, uint32_t order) {
+    powers[0] = 1.0;
+    for (uint32_t i = 1; i <= order; i++) {
+        powers[i] = powers[i - 1] * base / i;
+    }
+}
+
+FMM::FMM(const Config::Simulation& sim_cfg, Bodies& bodies)
+        : ThreadedSimulation(sim_cfg, bodies), theta_sq(sim_cfg.theta * sim_cfg.theta),
+          order(sim_cfg.fmm_order),
+          n_coeffs((order + 1) * (order + 2) / 2), reorder_interval(sim_cfg.reorder_interval),
+          qtree(Quadtree::BuildMode::PARTITION, sim_cfg.leaf_size),
+          max_subtree_bodies(std::max<uint64_t>(
+                  bodies.n / (n_threads * Constants::Simulation::FMM_SUBTREES_PER_THREAD), 1)),
+          acc_x(bodies.n), acc_y(bodies.n), thread_stats(n_threads) {
+    if (order > Constants::Simulation::FMM_ORDER_RANGE.second)
+        throw std::runtime_error("FMM order " + std::to_string(order) + " is not supported");
+
+    for (ThreadStats& stats : thread_stats) {
+        stats.derivatives.resize(n_coeffs);
+    }
+}
+
+FMM::~FMM() {
+    on_pause();
+
+    StopWatch sw_total = sw_tree + sw_upward + sw_downward + sw_int;
+    Log::debug("Tree:     [{}] ({})", sw_tree, sw_tree / sw_total);
+    Log::debug("Upward:   [{}] ({})", sw_upward, sw_upward / sw_total);
+    Log::debug("Downward: [{}] ({})", sw_downward, sw_downward / sw_total);
+    Log::debug("Int:      [{}] ({})", sw_int, sw_int / sw_total);
+
+    log_thread_times();
+    uint64_t m2l = 0;
+    uint64_t p2p_pairs = 0;
+    for (const ThreadStats& stats : thread_stats) {
+        m2l += stats.m2l;
+        p2p_pairs += stats.p2p_pairs;
+    }
+    if (iteration != 0) {
+        const double evaluations = static_cast<double>(iteration) * integrator.force_evaluations();
+        Log::debug("FMM order {}: {:.2f} M2L and {:.1f} P2P pairs per body per force evaluation",
+                order, m2l / evaluations / bodies.n, p2p_pairs / evaluations / bodies.n);
+    }
+}
+
+// The bodies move into the leaf order of the last tree every `reorder_interval` iterations
+void FMM::before_step() {
+    if (reorder_interval != 0 && iteration != 0 && iteration % reorder_interval == 0) {
+        sw_tree.resume();
+        bodies.reorder(force_tree.body_idxs);
+        sw_tree.pause();
+    }
+}
+
+// Every thread runs the integrator stages on its share of the bodies, the force evaluations
+// between them are shared
+void FMM::step(uint16_t thread_idx) {
+    if (needs_initial_forces())
+        evaluate_forces(thread_idx);
+    for (uint32_t stage = 0; stage <= integrator.stages(); stage++) {
+        integration_phase(thread_idx, stage);
+        if (stage < integrator.stages() && integrator.kicks_after(stage))
+            evaluate_forces(thread_idx);
+    }
+}
+
+// The master builds the tree and the top of the upward pass, the part above the subtrees, while
+// the workers are parked on the barriers. Every other pass is shared by all threads.
+void FMM::evaluate_forces(uint16_t thread_idx) {
+    const bool master = thread_idx == n_threads - 1;
+    if (master) {
+        sw_tree.resume();
+        build_tree();
+        subtree_counter.store(0, std::memory_order::relaxed);
+        sw_tree.pause();
+        sw_upward.resume();
+    }
+    sync_point.arrive_and_wait();
+
+    upward_pass(thread_idx);
+    wait_for_threads(thread_idx);
+    if (master) {
+        upward_top(0);
+        subtree_counter.store(0, std::memory_order::relaxed);
+        sw_upward.pause();
+        sw_downward.resume();
+    }
+    sync_point.arrive_and_wait();
+
+    downward_pass(thread_idx);
+    wait_for_threads(thread_idx);
+    if (master)
+        sw_downward.pause();
+}
+
+void FMM::build_tree() {
+    qtree.build_tree(bodies);
+    force_tree.pack(qtree);
+    const uint64_t n_nodes = force_tree.nodes.size();
+    multipoles.resize(n_nodes * n_coeffs);
+    locals.resize(n_nodes * n_coeffs);
+    radii.resize(n_nodes);
+    force_tree.collect_groups(max_subtree_bodies, subtrees);
+}
+
+// Threads claim subtrees one at a time until none are left
+template <typename F>
+void FMM::for_each_subtree(uint16_t thread_idx, F&& f) {
+    thread_times[thread_idx].busy.resume();
+    while (true) {
+        const uint64_t i = subtree_counter.fetch_add(1, std::memory_order::relaxed);
+        if (i >= subtrees.size())
+            break;
+        f(subtrees[i]);
+    }
+    thread_times[thread_idx].busy.pause();
+}
+
+void FMM::upward_pass(uint16_t thread_idx) {
+    for_each_subtree(thread_idx, [this](uint32_t node_idx) { upward(node_idx); });
+}
+
+// A subtree only receives M2L contributions from walks started at its own root, so the thread
+// that walks it can push its local expansions down right away
+void FMM::downward_pass(uint16_t thread_idx) {
+    ThreadStats& stats = thread_stats[thread_idx];
+    for_each_subtree(thread_idx, [this, &stats](uint32_t node_idx) {
+        const ForceTree::Node& node = force_tree.nodes[node_idx];
+        std::fill(acc_x.begin() + node.body_begin, acc_x.begin() + node.body_end, 0.0);
+        std::fill(acc_y.begin() + node.body_begin, acc_y.begin() + node.body_end, 0.0);
+        interact(node_idx, 0, stats);
+        downward(node_idx);
+    });
+}
+
+void FMM::integration_phase(uint16_t thread_idx, uint32_t stage) {
+    const bool master = thread_idx == n_threads - 1;
+    if (master)
+        sw_int.resume();
+    thread_times[thread_idx].busy.resume();
+    const uint64_t begin_idx = bodies.n * thread_idx / n_threads;
+    const uint64_t end_idx = bodies.n * (thread_idx + 1) / n_threads;
+    integrator.advance(bodies, stage, timestep, begin_idx, end_idx);
+    thread_times[thread_idx].busy.pause();
+    if (master)
+        sw_int.pause();
+    wait_for_threads(thread_idx);
+}
+
+// Coefficients are stored by total degree, the term x^a y^b of degree d = a + b at
+// d (d + 1) / 2 + b
+uint32_t FMM::coeff_idx(uint32_t x_degree, uint32_t y_degree) const {
+    const uint32_t degree = x_degree + y_degree;
+    return degree * (degree + 1) / 2 + y_degree;
+}
+
+// P2M at the leaves, M2M above them. The local expansions are cleared on the way.
+void FMM::upward(uint32_t node_idx) {
+    const ForceTree::Node& node = force_tree.nodes[node_idx];
+    std::fill_n(locals.begin() + node_idx * n_coeffs, n_coeffs, 0.0);
+    if (!node.is_leaf()) {
+        for (uint32_t child_idx = node.first_child; child_idx != node.next;
+                child_idx = force_tree.nodes[child_idx].next) {
+            upward(child_idx);
+        }
+        gather_children(node_idx);
+        return;
+    }
+
+    double* M = multipoles.data() + node_idx * n_coeffs;
+    std::fill_n(M, n_coeffs, 0.0);
+    double radius_sq = 0.0;
+    Powers x_pow, y_pow;
+    for (uint32_t i = node.body_begin; i < node.body_end; i++) {
+        const double dx = force_tree.body_x[i] - node.com_x;
+        const double dy = force_tree.body_y[i] - node.com_y;
+        radius_sq = std::max(radius_sq, dx * dx + dy * dy);
+        fill_scaled_powers(x_pow, -dx, order);
+        fill_scaled_powers(y_pow, -dy, order);
+        const double mass = force_tree.body_mass[i];
+        for (uint32_t degree = 0; degree <= order; degree++) {
+            for (uint32_t b = 0; b <= degree; b++) {
+                M[coeff_idx(degree - b, b)] += mass * x_pow[degree - b] * y_pow[b];
+            }
+        }
+    }
+    radii[node_idx] = std::sqrt(radius_sq);
+}
+
+// The nodes above the subtrees, whose expansions `upward` has already computed
+void FMM::upward_top(uint32_t node_idx) {
+    const ForceTree::Node& node = force_tree.nodes[node_idx];
+    if (node.is_leaf() || node.body_end - node.body_begin <= max_subtree_bodies)
+        return;
+    for (uint32_t child_idx = node.first_child; child_idx != node.next;
+            child_idx = force_tree.nodes[child_idx].next) {
+        upward_top(child_idx);
+    }
+    gather_children(node_idx);
+}
+
+// M2M: with d = child COM - node COM, M_k += sum over j <= k of M_child_j (-d)^(k-j) / (k-j)!
+void FMM::gather_children(uint32_t node_idx) {
+    const ForceTree::Node& node = force_tree.nodes[node_idx];
+    double* M = multipoles.data() + node_idx * n_coeffs;
+    std::fill_n(M, n_coeffs, 0.0);
+    double radius = 0.0;
+    Powers x_pow, y_pow;
+    for (uint32_t child_idx = node.first_child; child_idx != node.next;
+            child_idx = force_tree.nodes[child_idx].next) {
+        const ForceTree::Node& child = force_tree.nodes[child_idx];
+        const double* M_child = multipoles.data() + child_idx * n_coeffs;
+        const double dx = child.com_x - node.com_x;
+        const double dy = child.com_y - node.com_y;
+        radius = std::max(radius, std::sqrt(dx * dx + dy * dy) + radii[child_idx]);
+        fill_scaled_powers(x_pow, -dx, order);
+        fill_scaled_powers(y_pow, -dy, order);
+        for (uint32_t kx = 0; kx <= order; kx++) {
+            for (uint32_t ky = 0; kx + ky <= order; ky++) {
+                double sum = 0.0;
+                for (uint32_t jx = 0; jx <= kx; jx++) {
+                    for (uint32_t jy = 0; jy <= ky; jy++) {
+                        sum += M_child[coeff_idx(jx, jy)] * x_pow[kx - jx] * y_pow[ky - jy];
+                    }
+                }
+                M[coeff_idx(kx, ky)] += sum;
+            }
+        }
+    }
+    radii[node_idx] = radius;
+}
+
+// Dual tree walk accumulating into the target side only. Well separated pairs interact through
+// their expansions, otherwise the larger node is opened, down to pairs of leaves.
+void FMM::interact(uint32_t target_idx, uint32_t source_idx, ThreadStats& stats) {
+    const ForceTree::Node& target = force_tree.nodes[target_idx];
+    const ForceTree::Node& source = force_tree.nodes[source_idx];
+    const double dx = target.com_x - source.com_x;
+    const double dy = target.com_y - source.com_y;
+    const double radius_sum = radii[target_idx] + radii[source_idx];
+    if (radius_sum * radius_sum < theta_sq * (dx * dx + dy * dy)) {
+        m2l(target_idx, source_idx, stats);
+        return;
+    }
+    if (target.is_leaf() && source.is_leaf()) {
+        p2p(target_idx, source_idx, stats);
+        return;
+    }
+    if (source.is_leaf() || (!target.is_leaf() && radii[target_idx] >= radii[source_idx])) {
+        for (uint32_t child_idx = target.first_child; child_idx != target.next;
+                child_idx = force_tree.nodes[child_idx].next) {
+            interact(child_idx, source_idx, stats);
+        }
+    }
+    else {
+        for (uint32_t child_idx = source.first_child; child_idx != source.next;
+                child_idx = force_tree.nodes[child_idx].next) {
+            interact(target_idx, child_idx, stats);
+        }
+    }
+}
+
+// M2L: L_n += sum over k of T_(n+k) M_k, where T_q = d^q/dR^q (1 / |R|) at
+// R = target COM - source COM. 1 / sqrt(|R|^2 + eps^2) is 1 / r in 3D at height eps above the
+// plane, so the T_q of the softened kernel follow the 3D recurrence
+// |q| r^2 T_q = -(2|q| - 1) (qx Rx T_(q-ex) + qy Ry T_(q-ey))
+//               - (|q| - 1) (qx (qx - 1) T_(q-2ex) + qy (qy - 1) T_(q-2ey))
+void FMM::m2l(uint32_t target_idx, uint32_t source_idx, ThreadStats& stats) {
+    const ForceTree::Node& target = force_tree.nodes[target_idx];
+    const ForceTree::Node& source = force_tree.nodes[source_idx];
+    const double rx = target.com_x - source.com_x;
+    const double ry = target.com_y - source.com_y;
+    const double inv_r_sq = 1.0 / (rx * rx + ry * ry + epsilon_squared);
+
+    double* T = stats.derivatives.data();
+    T[0] = std::sqrt(inv_r_sq);
+    for (uint32_t degree = 1; degree <= order; degree++) {
+        for (uint32_t qy = 0; qy <= degree; qy++) {
+            const uint32_t qx = degree - qy;
+            double first = 0.0;
+            double second = 0.0;
+            if (qx >= 1)
+                first += qx * rx * T[coeff_idx(qx - 1, qy)];
+            if (qy >= 1)
+                first += qy * ry * T[coeff_idx(qx, qy - 1)];
+            if (qx >= 2)
+                second += qx * (qx - 1.0) * T[coeff_idx(qx - 2, qy)];
+            if (qy >= 2)
+                second += qy * (qy - 1.0) * T[coeff_idx(qx, qy - 2)];
+            T[coeff_idx(qx, qy)] =
+                    -((2.0 * degree - 1.0) * first + (degree - 1.0) * second) * inv_r_sq / degree;
+        }
+    }
+
+    // For a fixed n and degree of k, the T_(n+k) and M_k of the sum are contiguous
+    const double* M = multipoles.data() + source_idx * n_coeffs;
+    double* L = locals.data() + target_idx * n_coeffs;
+    for (uint32_t n_degree = 0; n_degree <= order; n_degree++) {
+        for (uint32_t ny = 0; ny <= n_degree; ny++) {
+            double sum = 0.0;
+            for (uint32_t k_degree = 0; n_degree + k_degree <= order; k_degree++) {
+                const double* T_row = T + coeff_idx(n_degree + k_degree - ny, ny);
+                const double* M_row = M + coeff_idx(k_degree, 0);
+                for (uint32_t ky = 0; ky <= k_degree; ky++) {
+                    sum += T_row[ky] * M_row[ky];
+                }
+            }
+            L[coeff_idx(n_degree - ny, ny)] += sum;
+        }
+    }
+    stats.m2l++;
+}
+
+void FMM::p2p(uint32_t target_idx, uint32_t source_idx, ThreadStats& stats) {
+    const ForceTree::Node& target = force_tree.nodes[target_idx];
+    const ForceTree::Node& source = force_tree.nodes[source_idx];
+    const uint32_t n_targets = target.body_end - target.body_begin;
+    const Gravity::Sources sources = {force_tree.body_x.data() + source.body_begin,
+            force_tree.body_y.data() + source.body_begin,
+            force_tree.body_mass.data() + source.body_begin, source.body_end - source.body_begin};
+    Gravity::accelerations(force_tree.body_x.data() + target.body_begin,
+            force_tree.body_y.data() + target.body_begin, n_targets, sources, epsilon_squared,
+            acc_x.data() + target.body_begin, acc_y.data() + target.body_begin);
+    stats.p2p_pairs += static_cast<uint64_t>(n_targets) * sources.n;
+}
+
+// L2L: with e = child COM - node COM, L_child_m += sum over i of L_(m+i) e^i / i!.
+// At the leaves, L2P: the acceleration is the gradient of the local expansion,
+// sum over m of (L_(m+ex), L_(m+ey)) s^m / m!, added to the direct sums of the leaf's bodies.
+void FMM::downward(uint32_t node_idx) {
+    const ForceTree::Node& node = force_tree.nodes[node_idx];
+    const double* L = locals.data() + node_idx * n_coeffs;
+    Powers x_pow, y_pow;
+    if (node.is_leaf()) {
+        const std::span<double> body_ax = bodies.ax();
+        const std::span<double> body_ay = bodies.ay();
+        for (uint32_t i = node.body_begin; i < node.body_end; i++) {
+            fill_scaled_powers(x_pow, force_tree.body_x[i] - node.com_x, order);
+            fill_scaled_powers(y_pow, force_tree.body_y[i] - node.com_y, order);
+            double ax = acc_x[i];
+            double ay = acc_y[i];
+            for (uint32_t degree = 0; degree < order; degree++) {
+                for (uint32_t my = 0; my <= degree; my++) {
+                    const uint32_t mx = degree - my;
+                    const double term = x_pow[mx] * y_pow[my];
+                    ax += L[coeff_idx(mx + 1, my)] * term;
+                    ay += L[coeff_idx(mx, my + 1)] * term;
+                }
+            }
+            const uint32_t body_idx = force_tree.body_idxs[i];
+            body_ax[body_idx] = Constants::Simulation::G * ax;
+            body_ay[body_idx] = Constants::Simulation::G * ay;
+        }
+        return;
+    }
+
+    for (uint32_t child_idx = node.first_child; child_idx != node.next;
+            child_idx = force_tree.nodes[child_idx].next) {
+        const ForceTree::Node& child = force_tree.nodes[child_idx];
+        double* L_child = locals.data() + child_idx * n_coeffs;
+        fill_scaled_powers(x_pow, child.com_x - node.com_x, order);
+        fill_scaled_powers(y_pow, child.com_y - node.com_y, order);
+        for (uint32_t mx = 0; mx <= order; mx++) {
+            for (uint32_t my = 0; mx + my <= order; my++) {
+                double sum = 0.0;
+                for (uint32_t ix = 0; mx + my + ix <= order; ix++) {
+                    for (uint32_t iy = 0; mx + my + ix + iy <= order; iy++) {
+                        sum += L[coeff_idx(mx + ix, my + iy)] * x_pow[ix] * y_pow[iy];
+                    }
+                }
+                L_child[coeff_idx(mx, my)] += sum;
+            }
+        }
+        downward(child_idx);
+    }
+}
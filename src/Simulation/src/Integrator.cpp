@@ -0,0 +1,193 @@
+#include "Simulation/Integrator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "Constants/Constants.hpp"
+#include "Logger/Logger.hpp"
+#include "Simulation/Kepler.hpp"
+
+
+Integrator::Integrator(Config::Simulation::Integrator type, const Bodies& bodies,
+        double epsilon_squared)
+        : epsilon_squared(epsilon_squared) {
+    switch (type) {
+    case Config::Simulation::Integrator::EULER:
+        kicks = {1.0, 0.0};
+        drifts = {1.0};
+        break;
+    case Config::Simulation::Integrator::LEAPFROG:
+        kicks = {0.5, 0.5};
+        drifts = {1.0};
+        break;
+    case Config::Simulation::Integrator::YOSHIDA4: {
+        // The kicks where two leapfrogs meet are merged
+        const double cbrt2 = std::cbrt(2.0);
+        const double w1 = 1.0 / (2.0 - cbrt2);
+        const double w0 = -cbrt2 * w1;
+        kicks = {0.5 * w1, 0.5 * (w0 + w1), 0.5 * (w0 + w1), 0.5 * w1};
+        drifts = {w1, w0, w1};
+        break;
+    }
+    case Config::Simulation::Integrator::FOREST_RUTH: {
+        // Omelyan, Mryglod, Folk, Comput. Phys. Commun. 146 (2002), eq. 20
+        constexpr double xi = 0.1786178958448091;
+        constexpr double lambda = -0.2123418310626054;
+        constexpr double chi = -0.06626458266981849;
+        kicks = {0.0, 0.5 * (1.0 - 2.0 * lambda), lambda, lambda, 0.5 * (1.0 - 2.0 * lambda),
+                0.0};
+        drifts = {xi, chi, 1.0 - 2.0 * (chi + xi), chi, xi};
+        break;
+    }
+    case Config::Simulation::Integrator::WISDOM_HOLMAN: {
+        // The drift is split in the orbits and the central body, without a kick between them
+        kicks = {0.5, 0.0, 0.0, 0.5};
+        drifts = {0.0, 1.0, 1.0};
+        const std::span<const double> masses = bodies.masses();
+        const uint64_t central_idx =
+                std::max_element(masses.begin(), masses.end()) - masses.begin();
+        central_body = bodies.original_index(central_idx);
+        double others_mass = 0.0;
+        for (uint64_t i = 0; i < bodies.n; i++) {
+            if (i != central_idx)
+                others_mass += masses[i];
+        }
+        Log::info("Wisdom-Holman central body: `{}`, {:.3e} times the mass of the others",
+                bodies.id(central_idx), masses[central_idx] / others_mass);
+        break;
+    }
+    }
+    assert(kicks.size() == drifts.size() + 1);
+}
+
+uint32_t Integrator::stages() const {
+    return drifts.size();
+}
+
+bool Integrator::starts_with_kick() const {
+    return kicks.front() != 0.0;
+}
+
+bool Integrator::kicks_after(uint32_t stage) const {
+    return kicks[stage + 1] != 0.0 || (stage + 1 == stages() && kicks.front() != 0.0);
+}
+
+uint32_t Integrator::force_evaluations() const {
+    uint32_t evaluations = 0;
+    for (uint32_t stage = 0; stage < stages(); stage++) {
+        evaluations += kicks_after(stage);
+    }
+    return evaluations;
+}
+
+uint64_t Integrator::unconverged_drifts() const {
+    return n_unconverged_drifts.load(std::memory_order::relaxed);
+}
+
+void Integrator::advance(Bodies& bodies, uint32_t stage, double timestep, uint64_t begin_idx,
+        uint64_t end_idx) const {
+    double* __restrict x = bodies.x().data();
+    double* __restrict y = bodies.y().data();
+    double* __restrict vx = bodies.vx().data();
+    double* __restrict vy = bodies.vy().data();
+    const double* __restrict ax = bodies.ax().data();
+    const double* __restrict ay = bodies.ay().data();
+    const double kick = kicks[stage] * timestep;
+    if (central_body != NO_CENTRAL_BODY) {
+        if (kick != 0.0)
+            central_kick(bodies, kick, begin_idx, end_idx);
+        if (stage < stages() && drifts[stage] != 0.0)
+            central_drift(bodies, stage, drifts[stage] * timestep, begin_idx, end_idx);
+        return;
+    }
+    if (kick != 0.0) {
+        for (uint64_t i = begin_idx; i < end_idx; i++) {
+            vx[i] += ax[i] * kick;
+            vy[i] += ay[i] * kick;
+        }
+    }
+    if (stage == stages())
+        return;
+    const double drift = drifts[stage] * timestep;
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        x[i] += vx[i] * drift;
+        y[i] += vy[i] * drift;
+    }
+}
+
+// The engines' accelerations hold the softened pull of the central body, and on the central body
+// the pull of the body. The Kepler drifts carry both, so they are taken out of the relative
+// acceleration: the central body gets its full kick, every other body its own plus the pair's.
+void Integrator::central_kick(Bodies& bodies, double kick, uint64_t begin_idx,
+        uint64_t end_idx) const {
+    const uint64_t central_idx = bodies.index_of(central_body);
+    const double* __restrict x = bodies.x().data();
+    const double* __restrict y = bodies.y().data();
+    double* __restrict vx = bodies.vx().data();
+    double* __restrict vy = bodies.vy().data();
+    const double* __restrict ax = bodies.ax().data();
+    const double* __restrict ay = bodies.ay().data();
+    const double* __restrict m = bodies.mass_data();
+    const double central_x = x[central_idx];
+    const double central_y = y[central_idx];
+    const double central_mass = m[central_idx];
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        double kx = ax[i];
+        double ky = ay[i];
+        const double rx = x[i] - central_x;
+        const double ry = y[i] - central_y;
+        const double r_sq = rx * rx + ry * ry + epsilon_squared;
+        // Like the engines, skips the central body and bodies at its exact position
+        if (r_sq != 0.0 && i != central_idx) {
+            const double pair = Constants::Simulation::G * (central_mass + m[i])
+                                / (r_sq * std::sqrt(r_sq));
+            kx += pair * rx;
+            ky += pair * ry;
+        }
+        vx[i] += kx * kick;
+        vy[i] += ky * kick;
+    }
+}
+
+// The first drift stage moves the other bodies relative to the central body, which is only moved
+// by the second one. The relative orbits are unsoftened.
+void Integrator::central_drift(Bodies& bodies, uint32_t stage, double drift, uint64_t begin_idx,
+        uint64_t end_idx) const {
+    const uint64_t central_idx = bodies.index_of(central_body);
+    double* __restrict x = bodies.x().data();
+    double* __restrict y = bodies.y().data();
+    double* __restrict vx = bodies.vx().data();
+    double* __restrict vy = bodies.vy().data();
+    if (stage == 2) {
+        if (begin_idx <= central_idx && central_idx < end_idx) {
+            x[central_idx] += vx[central_idx] * drift;
+            y[central_idx] += vy[central_idx] * drift;
+        }
+        return;
+    }
+    const double* __restrict m = bodies.mass_data();
+    const double central_x = x[central_idx];
+    const double central_y = y[central_idx];
+    const double central_vx = vx[central_idx];
+    const double central_vy = vy[central_idx];
+    const double central_mass = m[central_idx];
+    uint64_t unconverged = 0;
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        if (i == central_idx)
+            continue;
+        double rx = x[i] - central_x;
+        double ry = y[i] - central_y;
+        double ux = vx[i] - central_vx;
+        double uy = vy[i] - central_vy;
+        const double mu = Constants::Simulation::G * (central_mass + m[i]);
+        if (!Kepler::drift(mu, drift, rx, ry, ux, uy))
+            unconverged++;
+        x[i] = central_x + central_vx * drift + rx;
+        y[i] = central_y + central_vy * drift + ry;
+        vx[i] = central_vx + ux;
+        vy[i] = central_vy + uy;
+    }
+    if (unconverged > 0)
+        n_unconverged_drifts.fetch_add(unconverged, std::memory_order::relaxed);
+}
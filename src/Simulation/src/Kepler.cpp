@@ -0,0 +1,135 @@
+#include "Simulation/Kepler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+
+namespace {
+constexpr uint32_t MAX_ITERATIONS = 128;
+constexpr double TOLERANCE = 1e-15;
+
+// Stumpff functions c_k(z) = sum_j (-z)^j / (2j + k)!
+struct Stumpff {
+    double c0;
+    double c1;
+    double c2;
+    double c3;
+};
+
+// The closed forms of c2 and c3 cancel badly near 0, where the series converge fast
+Stumpff stumpff(double z) {
+    Stumpff c;
+    if (std::abs(z) < 0.1) {
+        c.c2 = 0.5 * (1.0 - z / 12.0 * (1.0 - z / 30.0 * (1.0 - z / 56.0 * (1.0 - z / 90.0
+                * (1.0 - z / 132.0 * (1.0 - z / 182.0))))));
+        c.c3 = (1.0 - z / 20.0 * (1.0 - z / 42.0 * (1.0 - z / 72.0 * (1.0 - z / 110.0
+                * (1.0 - z / 156.0 * (1.0 - z / 210.0)))))) / 6.0;
+        c.c0 = 1.0 - z * c.c2;
+        c.c1 = 1.0 - z * c.c3;
+    }
+    else if (z > 0.0) {
+        const double root = std::sqrt(z);
+        c.c0 = std::cos(root);
+        c.c1 = std::sin(root) / root;
+        c.c2 = (1.0 - c.c0) / z;
+        c.c3 = (1.0 - c.c1) / z;
+    }
+    else {
+        const double root = std::sqrt(-z);
+        c.c0 = std::cosh(root);
+        c.c1 = std::sinh(root) / root;
+        c.c2 = (1.0 - c.c0) / z;
+        c.c3 = (1.0 - c.c1) / z;
+    }
+    return c;
+}
+}  // namespace
+
+// With beta = 2 mu / r0 - v0^2 and G_k(s) = s^k c_k(beta s^2), the universal anomaly s solves
+// r0 G1 + eta0 G2 + mu G3 = t, whose derivative is the radius r. The left side increases with s,
+// so the root is bracketed first and the Laguerre-Conway iteration falls back to bisection
+// whenever it leaves the bracket, which happens on barely bound and near radial orbits. The f and
+// g functions then map the initial state to the final one. It converges once a step or the
+// bracket falls below the tolerance.
+bool Kepler::drift(double mu, double timestep, double& x, double& y, double& vx, double& vy) {
+    const double r0 = std::sqrt(x * x + y * y);
+    if (r0 == 0.0) {
+        x += vx * timestep;
+        y += vy * timestep;
+        return true;
+    }
+    const double eta0 = x * vx + y * vy;
+    const double beta = 2.0 * mu / r0 - (vx * vx + vy * vy);
+    const double zeta0 = mu - beta * r0;
+    const auto time_of = [&](double s) {
+        const Stumpff c = stumpff(beta * s * s);
+        return r0 * s * c.c1 + eta0 * s * s * c.c2 + mu * s * s * s * c.c3;
+    };
+
+    // A bound orbit repeats after its period, only the remainder needs solving, and a period is
+    // s = 2 pi / sqrt(beta). Otherwise the bracket grows from the guess until it holds t: on a
+    // hyperbola, t grows like exp(h s) with h = sqrt(-beta), which gives the guess for long times.
+    double t = timestep;
+    double s = t / r0;
+    double s_lo = 0.0;
+    double s_hi = s;
+    if (beta > 0.0) {
+        t = std::fmod(timestep, 2.0 * std::numbers::pi * mu / (beta * std::sqrt(beta)));
+        s_hi = 2.0 * std::numbers::pi / std::sqrt(beta);
+        s = std::min(t / r0, s_hi);
+    }
+    else {
+        const double h = std::sqrt(-beta);
+        const double scale = h * h * r0 + h * eta0 + mu;
+        if (h != 0.0 && scale > 0.0)
+            s = std::min(s, std::log1p(2.0 * h * h * h * t / scale) / h);
+        s_hi = s;
+        while (time_of(s_hi) < t) {
+            s_lo = s_hi;
+            s_hi *= 2.0;
+        }
+        s = s_hi;
+    }
+
+    constexpr double n = 5.0;  // Laguerre-Conway order
+    bool converged = false;
+    for (uint32_t i = 0; i < MAX_ITERATIONS && !converged; i++) {
+        const Stumpff c = stumpff(beta * s * s);
+        const double f = r0 * s * c.c1 + eta0 * s * s * c.c2 + mu * s * s * s * c.c3 - t;
+        if (f < 0.0)
+            s_lo = s;
+        else
+            s_hi = s;
+        const double df = r0 * c.c0 + eta0 * s * c.c1 + mu * s * s * c.c2;
+        const double ddf = eta0 * c.c0 + zeta0 * s * c.c1;
+        const double root =
+                std::sqrt(std::abs((n - 1.0) * (n - 1.0) * df * df - n * (n - 1.0) * f * ddf));
+        double next = s - n * f / (df + std::copysign(root, df));
+        if (!(next > s_lo && next < s_hi))
+            next = 0.5 * (s_lo + s_hi);
+        const double ds = next - s;
+        s = next;
+        converged = std::abs(ds) <= TOLERANCE * std::abs(s)
+                || s_hi - s_lo <= TOLERANCE * std::abs(s_hi);
+    }
+
+    const Stumpff c = stumpff(beta * s * s);
+    const double g1 = s * c.c1;
+    const double g2 = s * s * c.c2;
+    const double g3 = s * s * s * c.c3;
+    const double r = r0 * c.c0 + eta0 * g1 + mu * g2;
+    const double f = 1.0 - mu * g2 / r0;
+    const double g = t - mu * g3;
+    const double df = -mu * g1 / (r0 * r);
+    const double dg = 1.0 - mu * g2 / r;
+    const double x0 = x;
+    const double y0 = y;
+    x = f * x0 + g * vx;
+    y = f * y0 + g * vy;
+    const double vx0 = vx;
+    vx = df * x0 + dg * vx0;
+    vy = df * y0 + dg * vy;
+    return converged;
+}
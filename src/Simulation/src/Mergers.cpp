@@ -0,0 +1,77 @@
+#include "Simulation/Mergers.hpp"
+
+#include <cmath>
+#include <numeric>
+
+
+Mergers::Mergers(const Config::Simulation& sim_cfg, uint64_t n_bodies, uint64_t min_bodies)
+        : radius_sq(sim_cfg.merge_radius * sim_cfg.merge_radius), min_bodies(min_bodies),
+          nearest(radius_sq != 0.0 ? n_bodies : 0, NONE) {}
+
+bool Mergers::enabled() const {
+    return radius_sq != 0.0;
+}
+
+void Mergers::find_captures(const Bodies& bodies, const ForceTree& tree, uint64_t begin_idx,
+        uint64_t end_idx) {
+    const std::span<const double> px = bodies.x();
+    const std::span<const double> py = bodies.y();
+    const double radius = std::sqrt(radius_sq);
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        const double x = px[i];
+        const double y = py[i];
+        uint32_t best = NONE;
+        double best_dist_sq = radius_sq;
+        tree.visit_bodies_near(x, y, radius, [&](uint32_t k) {
+            const uint32_t j = tree.body_idxs[k];
+            const double rx = tree.body_x[k] - x;
+            const double ry = tree.body_y[k] - y;
+            const double dist_sq = rx * rx + ry * ry;
+            if (j != i && dist_sq < best_dist_sq) {
+                best = j;
+                best_dist_sq = dist_sq;
+            }
+        });
+        nearest[i] = best;
+    }
+}
+
+// Every mutual pair is visited once, from its lower index
+bool Mergers::merge(Bodies& bodies) {
+    const uint64_t n = bodies.n;
+    const std::span<const double> m = bodies.masses();
+    into.resize(n);
+    std::iota(into.begin(), into.end(), 0);
+    uint64_t merges = 0;
+    for (uint32_t i = 0; i < n && n - merges > min_bodies; i++) {
+        const uint32_t j = nearest[i];
+        if (j == NONE || j < i || nearest[j] != i)
+            continue;
+        if (m[i] >= m[j])
+            into[j] = i;
+        else
+            into[i] = j;
+        merges++;
+    }
+    if (merges == 0)
+        return false;
+
+    new_idxs.resize(n);
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        new_idxs[i] = into[i] == i ? count++ : NONE;
+    }
+    bodies.merge(into);
+    nearest.resize(bodies.n);
+    stats.merges += merges;
+    stats.passes++;
+    return true;
+}
+
+std::span<const uint32_t> Mergers::get_new_indices() const {
+    return new_idxs;
+}
+
+const Mergers::Stats& Mergers::get_stats() const {
+    return stats;
+}
@@ -0,0 +1,107 @@
+#include "Simulation/ParticleMesh.hpp"
+
+#include "Logger/Logger.hpp"
+
+
+ParticleMesh::ParticleMesh(const Config::Simulation& sim_cfg, Bodies& bodies)
+        : ThreadedSimulation(sim_cfg, bodies),
+          mesh(sim_cfg, epsilon_squared, 0.0, bodies.n) {
+    mesh.fit(bodies);
+}
+
+ParticleMesh::~ParticleMesh() {
+    on_pause();
+
+    StopWatch sw_total = sw_deposit + sw_solve + sw_interp + sw_int;
+    Log::debug("Deposit: [{}] ({})", sw_deposit, sw_deposit / sw_total);
+    Log::debug("Solve:   [{}] ({})", sw_solve, sw_solve / sw_total);
+    Log::debug("Interp:  [{}] ({})", sw_interp, sw_interp / sw_total);
+    Log::debug("Int:     [{}] ({})", sw_int, sw_int / sw_total);
+    log_thread_times();
+    Log::debug("PM mesh {}x{} ({}), cell size {:.3e}, {} fits", mesh.size(), mesh.size(),
+            mesh.is_periodic() ? "periodic" : "isolated", mesh.cell_size(), mesh.fit_count());
+}
+
+// Every thread runs the integrator stages on its share of the bodies, the force evaluations
+// between them are shared
+void ParticleMesh::step(uint16_t thread_idx) {
+    if (needs_initial_forces())
+        evaluate_forces(thread_idx);
+    for (uint32_t stage = 0; stage <= integrator.stages(); stage++) {
+        integration_phase(thread_idx, stage);
+        if (stage < integrator.stages() && integrator.kicks_after(stage))
+            evaluate_forces(thread_idx);
+    }
+}
+
+// The master re-fits the isolated mesh while the workers are parked on the barrier, the rest is
+// shared by all threads. Only the master's view of the phases is timed, it waits for the slowest
+// thread in each. The interpolation and the stage after it only touch the thread's own bodies,
+// so no barrier separates them.
+void ParticleMesh::evaluate_forces(uint16_t thread_idx) {
+    const bool master = thread_idx == n_threads - 1;
+    StopWatch& busy = thread_times[thread_idx].busy;
+    const auto wait = [this, thread_idx, &busy]() {
+        busy.pause();
+        wait_for_threads(thread_idx);
+        busy.resume();
+    };
+
+    if (master) {
+        sw_deposit.resume();
+        mesh.refit();
+    }
+    sync_point.arrive_and_wait();
+
+    busy.resume();
+    mesh.deposit(bodies, thread_idx, wait);
+    wait();
+    if (master) {
+        sw_deposit.pause();
+        sw_solve.resume();
+    }
+    mesh.solve(thread_idx, wait);
+    wait();
+    if (master) {
+        sw_solve.pause();
+        sw_interp.resume();
+    }
+    interpolate(thread_idx);
+    busy.pause();
+    if (master)
+        sw_interp.pause();
+}
+
+std::pair<uint64_t, uint64_t> ParticleMesh::thread_range(uint16_t thread_idx) const {
+    return {bodies.n * thread_idx / n_threads, bodies.n * (thread_idx + 1) / n_threads};
+}
+
+void ParticleMesh::interpolate(uint16_t thread_idx) {
+    const auto [begin_idx, end_idx] = thread_range(thread_idx);
+    const double* __restrict x = bodies.x().data();
+    const double* __restrict y = bodies.y().data();
+    double* __restrict ax = bodies.ax().data();
+    double* __restrict ay = bodies.ay().data();
+    for (uint64_t i = begin_idx; i < end_idx; i++) {
+        const sf::Vector2<double> acc = mesh.acceleration(x[i], y[i]);
+        ax[i] = Constants::Simulation::G * acc.x;
+        ay[i] = Constants::Simulation::G * acc.y;
+    }
+}
+
+// After a drift the mesh tracks the bodies, the master re-fits it before the next force evaluation
+void ParticleMesh::integration_phase(uint16_t thread_idx, uint32_t stage) {
+    const bool master = thread_idx == n_threads - 1;
+    StopWatch& busy = thread_times[thread_idx].busy;
+    if (master)
+        sw_int.resume();
+    busy.resume();
+    const auto [begin_idx, end_idx] = thread_range(thread_idx);
+    integrator.advance(bodies, stage, timestep, begin_idx, end_idx);
+    if (stage < integrator.stages())
+        mesh.track(bodies, thread_idx);
+    busy.pause();
+    if (master)
+        sw_int.pause();
+    wait_for_threads(thread_idx);
+}
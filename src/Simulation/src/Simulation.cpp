@@ -1,5 +1,6 @@
 #include "Simulation/Simulation.hpp"
 
+#include <algorithm>
 #include <random>
 #include <stack>
 
@@ -8,13 +9,24 @@
 #include "Logger/Logger.hpp"
 
 
-Simulation::Simulation(const Config::Simulation& sim_cfg, Bodies& bodies)
+Simulation::Simulation(const Config::Simulation& sim_cfg, Bodies& bodies, uint16_t n_threads)
         : bodies(bodies), max_iterations(sim_cfg.iterations), requested_timestep(sim_cfg.timestep),
-          timestep(sim_cfg.timestep),
+          timestep(sim_cfg.timestep), adaptive_timestep(sim_cfg.adaptive_timestep),
+          timestep_eta(sim_cfg.timestep_eta),
           epsilon_squared(
-                  std::pow(compute_plummer_softening(bodies, sim_cfg.softening_factor), 2)) {}
+                  std::pow(compute_plummer_softening(bodies, sim_cfg.softening_factor), 2)),
+          integrator(sim_cfg.integrator, bodies, epsilon_squared),
+          block_timesteps(sim_cfg, std::sqrt(epsilon_squared), bodies.n),
+          thread_pool(n_threads) {
+    stats.timestep_s = timestep;
+}
 
-Simulation::~Simulation() {}
+Simulation::~Simulation() {
+    if (integrator.unconverged_drifts() > 0) {
+        Log::warning("Wisdom-Holman: the Kepler solver did not converge on {} drifts",
+                integrator.unconverged_drifts());
+    }
+}
 
 Simulation::State Simulation::get_state() {
     std::lock_guard state_lock(state_mtx);
@@ -65,18 +77,41 @@ bool Simulation::should_stop() {
     return stop;
 }
 
+bool Simulation::needs_initial_forces() const {
+    return iteration == 0 && integrator.starts_with_kick();
+}
+
 void Simulation::post_iteration() {
     stats_update_rate_limiter.try_call(std::bind(&Simulation::update_stats, this));
-    timestep = requested_timestep.load(std::memory_order::relaxed);
+    simulated_time += timestep;
+    timestep = adaptive_timestep ? adapted_timestep()
+                                 : requested_timestep.load(std::memory_order::relaxed);
     iteration++;
 }
 
+// The largest step within dt = sqrt(2 eta epsilon / |a|) for every body, from the accelerations of
+// the last force evaluation. It grows by a bounded factor, so one quiet iteration does not throw
+// the next one far ahead.
+double Simulation::adapted_timestep() const {
+    using namespace Constants::Simulation;
+    const double* __restrict ax = bodies.ax().data();
+    const double* __restrict ay = bodies.ay().data();
+    double max_acc_sq = 0.0;
+    for (uint64_t i = 0; i < bodies.n; i++) {
+        max_acc_sq = std::max(max_acc_sq, ax[i] * ax[i] + ay[i] * ay[i]);
+    }
+    double dt = timestep * ADAPTIVE_TIMESTEP_MAX_GROWTH;
+    if (max_acc_sq != 0.0)
+        dt = std::min(dt, std::sqrt(2.0 * timestep_eta * std::sqrt(epsilon_squared / max_acc_sq)));
+    return std::clamp(dt, TIMESTEP_RANGE.first, TIMESTEP_RANGE.second);
+}
+
 sf::Vector2<double> Simulation::force(const sf::Vector2<double>& pos_a,
         const sf::Vector2<double>& pos_b, double mass_a, double mass_b) const {
-    const double dist = distance(pos_a, pos_b);
-    const double force_amplitude =
-            Constants::Simulation::G * mass_a * mass_b / (dist * dist + epsilon_squared);
-    return force_amplitude * (pos_b - pos_a) / dist;
+    const sf::Vector2<double> diff = pos_b - pos_a;
+    const double softened_dist_sq = diff.lengthSquared() + epsilon_squared;
+    return Constants::Simulation::G * mass_a * mass_b
+           / (softened_dist_sq * std::sqrt(softened_dist_sq)) * diff;
 }
 
 double Simulation::compute_plummer_softening(const Bodies& bodies, double factor,
@@ -146,5 +181,6 @@ void Simulation::update_stats() {
     stats.iteration = iteration;
     stats.ips = ips_calculator.get_mean<float>();
     stats.real_elapsed_s = elapsed_s;
-    stats.simulated_elapsed_s += iter_delta * timestep;
+    stats.simulated_elapsed_s = simulated_time;
+    stats.timestep_s = timestep;
 }
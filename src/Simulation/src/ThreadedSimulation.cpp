@@ -0,0 +1,74 @@
+#include "Simulation/ThreadedSimulation.hpp"
+
+#include <stdexcept>
+
+#include "Logger/Logger.hpp"
+
+
+ThreadedSimulation::ThreadedSimulation(const Config::Simulation& sim_cfg, Bodies& bodies)
+        : Simulation(sim_cfg, bodies, sim_cfg.threads), n_threads(sim_cfg.threads),
+          thread_times(n_threads), sync_point(n_threads) {
+    if (sim_cfg.threads == 0)
+        throw std::runtime_error("Thread count 0 is invalid");
+    if (sim_cfg.threads > bodies.n)
+        throw std::runtime_error("Threads must be less than the number of bodies");
+}
+
+// The last pool thread is the master, the others are workers
+void ThreadedSimulation::on_run() {
+    stop = false;
+    worker_stop = false;
+    thread_pool.launch([this](uint16_t thread_idx) {
+        if (thread_idx == n_threads - 1)
+            simulate();
+        else
+            worker_task(thread_idx);
+    });
+}
+
+void ThreadedSimulation::on_pause() {
+    stop = true;
+    thread_pool.wait();
+}
+
+void ThreadedSimulation::simulate() {
+    const uint16_t thread_idx = n_threads - 1;
+    while (!should_stop()) {
+        before_step();
+        // The workers are parked on the barrier until the step starts
+        sync_point.arrive_and_wait();
+        step(thread_idx);
+        after_step();
+        post_iteration();
+    }
+
+    // Release the workers waiting for the next iteration
+    worker_stop = true;
+    sync_point.arrive_and_wait();
+}
+
+void ThreadedSimulation::worker_task(uint16_t thread_idx) {
+    while (true) {
+        sync_point.arrive_and_wait();
+        if (worker_stop)
+            return;
+        step(thread_idx);
+    }
+}
+
+void ThreadedSimulation::wait_for_threads(uint16_t thread_idx) {
+    thread_times[thread_idx].idle.resume();
+    sync_point.arrive_and_wait();
+    thread_times[thread_idx].idle.pause();
+}
+
+// A thread that never ran has no idle share
+void ThreadedSimulation::log_thread_times() const {
+    for (uint16_t t = 0; t < n_threads; t++) {
+        const ThreadTimes& times = thread_times[t];
+        const StopWatch total = times.busy + times.idle;
+        Log::debug("Thread {:>3}: busy [{}] idle [{}] ({:.3f})", t, times.busy, times.idle,
+                total.duration<std::chrono::nanoseconds>().count() != 0 ? times.idle / total
+                                                                        : 0.0);
+    }
+}
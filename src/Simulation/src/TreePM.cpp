@@ -0,0 +1,254 @@
+#include "Simulation/TreePM.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Logger/Logger.hpp"
+
+
+// Intervals of the short range table
+constexpr uint32_t SHORT_RANGE_TABLE_SIZE = 4096;
+
+TreePM::TreePM(const Config::Simulation& sim_cfg, Bodies& bodies)
+        : ThreadedSimulation(sim_cfg, bodies), theta_sq(sim_cfg.theta * sim_cfg.theta),
+          reorder_interval(sim_cfg.reorder_interval),
+          mesh(sim_cfg, epsilon_squared, sim_cfg.treepm_split, bodies.n),
+          qtree(Quadtree::BuildMode::PARTITION, sim_cfg.leaf_size),
+          short_range_table(SHORT_RANGE_TABLE_SIZE + 1), thread_data(n_threads) {
+    using Constants::Simulation::TREEPM_CUTOFF_SPLITS;
+    // With u = R / 2 r_s, the short range force is the softened force times
+    // erfc(u) + 2u exp(-u^2) / sqrt(pi)
+    const double q_cut = TREEPM_CUTOFF_SPLITS * TREEPM_CUTOFF_SPLITS;
+    for (uint32_t i = 0; i <= SHORT_RANGE_TABLE_SIZE; i++) {
+        const double u = 0.5 * std::sqrt(q_cut * i / SHORT_RANGE_TABLE_SIZE);
+        short_range_table[i] = std::erfc(u) + 2.0 * u * std::exp(-u * u) / std::sqrt(M_PI);
+    }
+
+    mesh.fit(bodies);
+}
+
+TreePM::~TreePM() {
+    on_pause();
+
+    StopWatch sw_total = sw_tree + sw_mesh + sw_short + sw_int;
+    Log::debug("Tree:  [{}] ({})", sw_tree, sw_tree / sw_total);
+    Log::debug("Mesh:  [{}] ({})", sw_mesh, sw_mesh / sw_total);
+    Log::debug("Short: [{}] ({})", sw_short, sw_short / sw_total);
+    Log::debug("Int:   [{}] ({})", sw_int, sw_int / sw_total);
+
+    log_thread_times();
+    uint64_t interactions = 0;
+    for (const ThreadData& data : thread_data) {
+        interactions += data.interactions;
+    }
+    Log::debug("TreePM mesh {}x{} ({}), r_s {:.3e}, {} fits", mesh.size(), mesh.size(),
+            mesh.is_periodic() ? "periodic" : "isolated", mesh.split_scale(), mesh.fit_count());
+    if (iteration != 0) {
+        Log::debug("{:.1f} short range interactions per body per force evaluation",
+                static_cast<double>(interactions) / iteration / integrator.force_evaluations()
+                        / bodies.n);
+    }
+}
+
+// The bodies move into the leaf order of the last tree every `reorder_interval` iterations
+void TreePM::before_step() {
+    if (reorder_interval != 0 && iteration != 0 && iteration % reorder_interval == 0) {
+        sw_tree.resume();
+        bodies.reorder(force_tree.body_idxs);
+        sw_tree.pause();
+    }
+}
+
+// Every thread runs the integrator stages on its share of the bodies, the force evaluations
+// between them are shared
+void TreePM::step(uint16_t thread_idx) {
+    if (needs_initial_forces())
+        evaluate_forces(thread_idx);
+    for (uint32_t stage = 0; stage <= integrator.stages(); stage++) {
+        integration_phase(thread_idx, stage);
+        if (stage < integrator.stages() && integrator.kicks_after(stage))
+            evaluate_forces(thread_idx);
+    }
+}
+
+// The master builds the tree and re-fits the isolated mesh while the workers are parked on the
+// barrier, every other phase is shared by all threads. Nobody claims groups before the barrier
+// is passed.
+void TreePM::evaluate_forces(uint16_t thread_idx) {
+    const bool master = thread_idx == n_threads - 1;
+    if (master) {
+        sw_tree.resume();
+        build_tree();
+        mesh.refit();
+        group_counter.store(0, std::memory_order::relaxed);
+        sw_tree.pause();
+        sw_mesh.resume();
+    }
+    sync_point.arrive_and_wait();
+
+    mesh_phase(thread_idx);
+    wait_for_threads(thread_idx);
+    if (master) {
+        sw_mesh.pause();
+        sw_short.resume();
+    }
+    short_range_phase(thread_idx);
+    wait_for_threads(thread_idx);
+    if (master)
+        sw_short.pause();
+}
+
+void TreePM::build_tree() {
+    qtree.build_tree(bodies);
+    force_tree.pack(qtree);
+    force_tree.collect_groups(Constants::Simulation::GROUP_WALK_MAX_BODIES, groups);
+}
+
+void TreePM::mesh_phase(uint16_t thread_idx) {
+    StopWatch& busy = thread_times[thread_idx].busy;
+    const auto wait = [this, thread_idx, &busy]() {
+        busy.pause();
+        wait_for_threads(thread_idx);
+        busy.resume();
+    };
+    busy.resume();
+    mesh.deposit(bodies, thread_idx, wait);
+    wait();
+    mesh.solve(thread_idx, wait);
+    busy.pause();
+}
+
+// Groups are claimed in chunks, their cost varies with the local density
+void TreePM::short_range_phase(uint16_t thread_idx) {
+    using namespace Constants::Simulation;
+    ThreadData& data = thread_data[thread_idx];
+    const uint64_t chunk = std::max(DYNAMIC_CHUNK_BODIES / GROUP_WALK_MAX_BODIES, 1u);
+    thread_times[thread_idx].busy.resume();
+    while (true) {
+        const uint64_t begin = group_counter.fetch_add(chunk, std::memory_order::relaxed);
+        if (begin >= groups.size())
+            break;
+        const uint64_t end = std::min<uint64_t>(begin + chunk, groups.size());
+        for (uint64_t g = begin; g < end; g++) {
+            update_group(groups[g], data);
+        }
+    }
+    thread_times[thread_idx].busy.pause();
+}
+
+// One walk for all bodies of the group, as in BarnesHut::update_group_acceleration. A node is
+// skipped when even its farthest possible body (within sqrt(2) widths of the COM) lies beyond the
+// cutoff from the group's bounding box, and accepted when the opening criterion holds for the
+// closest point of that box. The accelerations of the bodies are the short range sum and the
+// mesh's.
+void TreePM::update_group(uint32_t group_idx, ThreadData& data) {
+    const std::vector<ForceTree::Node>& nodes = force_tree.nodes;
+    const ForceTree::Node& group = nodes[group_idx];
+    const double* x = force_tree.body_x.data();
+    const double* y = force_tree.body_y.data();
+    const double* m = force_tree.body_mass.data();
+
+    double x_min = x[group.body_begin], x_max = x_min;
+    double y_min = y[group.body_begin], y_max = y_min;
+    for (uint32_t i = group.body_begin + 1; i < group.body_end; i++) {
+        x_min = std::min(x_min, x[i]);
+        x_max = std::max(x_max, x[i]);
+        y_min = std::min(y_min, y[i]);
+        y_max = std::max(y_max, y[i]);
+    }
+    const double center_x = 0.5 * (x_min + x_max);
+    const double center_y = 0.5 * (y_min + y_max);
+    const double r_s = mesh.split_scale();
+    const double cutoff = Constants::Simulation::TREEPM_CUTOFF_SPLITS * r_s;
+    const double side = mesh.box_side();
+    const bool periodic = mesh.is_periodic();
+    // Shift of the nearest image of a point to the group
+    const auto image = [periodic, side](double d) {
+        return periodic ? -side * std::round(d / side) : 0.0;
+    };
+
+    data.x.clear();
+    data.y.clear();
+    data.mass.clear();
+    uint32_t node_idx = 0;
+    while (node_idx != ForceTree::END) {
+        const ForceTree::Node& node = nodes[node_idx];
+        if (node.is_leaf()) {
+            for (uint32_t i = node.body_begin; i < node.body_end; i++) {
+                data.x.push_back(x[i] + image(x[i] - center_x));
+                data.y.push_back(y[i] + image(y[i] - center_y));
+                data.mass.push_back(m[i]);
+            }
+            node_idx = node.next;
+            continue;
+        }
+        const double com_x = node.com_x + image(node.com_x - center_x);
+        const double com_y = node.com_y + image(node.com_y - center_y);
+        const double dx = std::max({x_min - com_x, com_x - x_max, 0.0});
+        const double dy = std::max({y_min - com_y, com_y - y_max, 0.0});
+        const double dist_sq = dx * dx + dy * dy;
+        const double reach = cutoff + std::sqrt(2.0 * node.width_sq);
+        if (dist_sq > reach * reach) {
+            node_idx = node.next;
+        }
+        else if (node.width_sq < theta_sq * dist_sq) {
+            data.x.push_back(com_x);
+            data.y.push_back(com_y);
+            data.mass.push_back(node.mass);
+            node_idx = node.next;
+        }
+        else {
+            node_idx = node.first_child;
+        }
+    }
+
+    const uint32_t list_size = data.x.size();
+    const uint32_t group_size = group.body_end - group.body_begin;
+    const double cutoff_sq = cutoff * cutoff;
+    const double table_scale = SHORT_RANGE_TABLE_SIZE / cutoff_sq;
+    for (uint32_t k = 0; k < group_size; k++) {
+        const uint32_t i = group.body_begin + k;
+        double ax = 0.0;
+        double ay = 0.0;
+        for (uint32_t j = 0; j < list_size; j++) {
+            const double dx = data.x[j] - x[i];
+            const double dy = data.y[j] - y[i];
+            const double dist_sq = dx * dx + dy * dy;
+            const double soft_sq = dist_sq + epsilon_squared;
+            if (dist_sq == 0.0 || soft_sq >= cutoff_sq)
+                continue;
+            const double t = soft_sq * table_scale;
+            // soft_sq just below the cutoff may round up to the last entry
+            const uint32_t t_idx = std::min(static_cast<uint32_t>(t), SHORT_RANGE_TABLE_SIZE - 1);
+            const double frac = t - t_idx;
+            const double factor = short_range_table[t_idx] * (1.0 - frac)
+                                  + short_range_table[t_idx + 1] * frac;
+            const double f = data.mass[j] * factor / (soft_sq * std::sqrt(soft_sq));
+            ax += dx * f;
+            ay += dy * f;
+        }
+        const sf::Vector2<double> mesh_acc = mesh.acceleration(x[i], y[i]);
+        const uint32_t body_idx = force_tree.body_idxs[i];
+        bodies.ax()[body_idx] = Constants::Simulation::G * (ax + mesh_acc.x);
+        bodies.ay()[body_idx] = Constants::Simulation::G * (ay + mesh_acc.y);
+    }
+    data.interactions += static_cast<uint64_t>(list_size) * group_size;
+}
+
+// After a drift the mesh tracks the bodies, the master re-fits it before the next force evaluation
+void TreePM::integration_phase(uint16_t thread_idx, uint32_t stage) {
+    const bool master = thread_idx == n_threads - 1;
+    StopWatch& busy = thread_times[thread_idx].busy;
+    if (master)
+        sw_int.resume();
+    busy.resume();
+    const uint64_t begin_idx = bodies.n * thread_idx / n_threads;
+    const uint64_t end_idx = bodies.n * (thread_idx + 1) / n_threads;
+    integrator.advance(bodies, stage, timestep, begin_idx, end_idx);
+    if (stage < integrator.stages())
+        mesh.track(bodies, thread_idx);
+    busy.pause();
+    if (master)
+        sw_int.pause();
+    wait_for_threads(thread_idx);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+
+// std::allocator replacement returning storage aligned to `ALIGNMENT` bytes
+template <typename T, std::size_t ALIGNMENT>
+struct AlignedAllocator {
+    static_assert(ALIGNMENT >= alignof(T) && (ALIGNMENT & (ALIGNMENT - 1)) == 0);
+
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, ALIGNMENT>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{ALIGNMENT}));
+    }
+    void deallocate(T* ptr, std::size_t) {
+        ::operator delete(ptr, std::align_val_t{ALIGNMENT});
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, ALIGNMENT>&) const {
+        return true;
+    }
+};
@@ -1,15 +1,36 @@
 #pragma once
 
 #include <inttypes.h>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
 #include <vector>
 
+#include "Body/AlignedAllocator.hpp"
 #include "SFML/System/Vector2.hpp"
 
 
+// Bodies are stored as separate x, y, vx, vy, ax, ay and mass columns (SoA). Every column starts
+// on a cache line and holds at least `padded_n` elements, the padding is zero so that SIMD loops
+// may run over whole vectors. The per-body accessors return copies, bulk loops should use the
+// columns.
+// The engines may reorder the bodies for locality, `original_index`/`index_of` map between the
+// current storage index and the input (CSV) order. Bodies that merge are compacted away, n then
+// shrinks and `index_of` maps an absorbed input body to the body it merged into.
+// Reordering and merging move the bodies under the layout lock, readers running alongside the
+// engine (the renderer) hold it to see a consistent layout.
+// The ax, ay columns hold the accelerations of the last force evaluation, which the integrators
+// carry over to the next step.
 class Bodies {
 public:
-    const uint64_t n;
+    static constexpr uint64_t ALIGNMENT = 64;  // bytes
+    static constexpr uint64_t SIMD_WIDTH = ALIGNMENT / sizeof(double);
+    using Column = std::vector<double, AlignedAllocator<double, ALIGNMENT>>;
+
+    uint64_t n;
+    uint64_t padded_n;  // n rounded up to SIMD_WIDTH
+    const uint64_t input_n;  // bodies read from the input, n shrinks below it when bodies merge
 
     Bodies() = delete;
     Bodies(std::vector<std::string>&& id, std::vector<double>&& mass,
@@ -19,22 +40,53 @@ public:
     const std::string& id(uint64_t index) const;
     double& mass(uint64_t index);
     const double& mass(uint64_t index) const;
-    sf::Vector2<double>& pos(uint64_t index);
-    const sf::Vector2<double>& pos(uint64_t index) const;
-    sf::Vector2<double>& vel(uint64_t index);
-    const sf::Vector2<double>& vel(uint64_t index) const;
+    sf::Vector2<double> pos(uint64_t index) const;
+    void set_pos(uint64_t index, const sf::Vector2<double>& pos);
+    sf::Vector2<double> vel(uint64_t index) const;
+    void set_vel(uint64_t index, const sf::Vector2<double>& vel);
+
+    // Columns of the n bodies, the padding lies past their end
+    std::span<double> x();
+    std::span<const double> x() const;
+    std::span<double> y();
+    std::span<const double> y() const;
+    std::span<double> vx();
+    std::span<const double> vx() const;
+    std::span<double> vy();
+    std::span<const double> vy() const;
+    std::span<double> ax();
+    std::span<const double> ax() const;
+    std::span<double> ay();
+    std::span<const double> ay() const;
+    std::span<double> masses();
+    std::span<const double> masses() const;
     double* mass_data();
     const double* mass_data() const;
-    sf::Vector2<double>* pos_data();
-    const sf::Vector2<double>* pos_data() const;
-    sf::Vector2<double>* vel_data();
-    const sf::Vector2<double>* vel_data() const;
+
+    std::unique_lock<std::mutex> lock_layout() const;
+    uint64_t original_index(uint64_t index) const;
+    uint64_t index_of(uint64_t original_index) const;
+    // The body at `order[i]` moves to index i, `order` must be a permutation of [0, n)
+    void reorder(std::span<const uint32_t> order);
+    // Body i merges into body `into[i]`, the survivors map to themselves. Mass and momentum are
+    // conserved, the survivors keep their id and order and are compacted to the front.
+    void merge(std::span<const uint32_t> into);
+    // Whether the input body merged into another one
+    bool absorbed(uint64_t original_index) const;
 
 private:
     std::vector<std::string> id_;
-    std::vector<double> mass_;
-    std::vector<sf::Vector2<double>> pos_;
-    std::vector<sf::Vector2<double>> vel_;
+    Column mass_;
+    Column x_;
+    Column y_;
+    Column vx_;
+    Column vy_;
+    Column ax_;
+    Column ay_;
+    std::vector<uint32_t> original_idxs_;
+    std::vector<uint32_t> idxs_;  // inverse of original_idxs_
+    Column reorder_buffer_;
+    std::unique_ptr<std::mutex> layout_mtx_;  // behind a pointer so that Bodies stays movable
 
     bool validate_ids() const;
 };
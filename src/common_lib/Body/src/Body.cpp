@@ -1,21 +1,31 @@
 #include "Body/Body.hpp"
 
+#include <algorithm>
+#include <numeric>
 #include <unordered_set>
 
 #include "Logger/Logger.hpp"
 
 Bodies::Bodies(std::vector<std::string>&& id, std::vector<double>&& mass,
         std::vector<sf::Vector2<double>>&& pos, std::vector<sf::Vector2<double>>&& vel)
-        : n(id.size()), id_(std::move(id)), mass_(std::move(mass)), pos_(std::move(pos)),
-          vel_(std::move(vel)) {
+        : n(id.size()), padded_n((n + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH), input_n(n),
+          id_(std::move(id)), mass_(padded_n, 0.0), x_(padded_n, 0.0), y_(padded_n, 0.0),
+          vx_(padded_n, 0.0), vy_(padded_n, 0.0), ax_(padded_n, 0.0), ay_(padded_n, 0.0),
+          original_idxs_(n), idxs_(n), layout_mtx_(std::make_unique<std::mutex>()) {
     assert(id_.size() == n);
-    assert(mass_.size() == n);
-    assert(pos_.size() == n);
-    assert(vel_.size() == n);
+    assert(mass.size() == n);
+    assert(pos.size() == n);
+    assert(vel.size() == n);
     id_.shrink_to_fit();
-    mass_.shrink_to_fit();
-    pos_.shrink_to_fit();
-    vel_.shrink_to_fit();
+    for (uint64_t i = 0; i < n; i++) {
+        mass_[i] = mass[i];
+        x_[i] = pos[i].x;
+        y_[i] = pos[i].y;
+        vx_[i] = vel[i].x;
+        vy_[i] = vel[i].y;
+    }
+    std::iota(original_idxs_.begin(), original_idxs_.end(), 0);
+    std::iota(idxs_.begin(), idxs_.end(), 0);
 }
 
 bool Bodies::validate() const {
@@ -51,24 +61,82 @@ const double& Bodies::mass(uint64_t index) const {
     return mass_[index];
 }
 
-sf::Vector2<double>& Bodies::pos(uint64_t index) {
+sf::Vector2<double> Bodies::pos(uint64_t index) const {
     assert(index <= n);
-    return pos_[index];
+    return {x_[index], y_[index]};
 }
 
-const sf::Vector2<double>& Bodies::pos(uint64_t index) const {
+void Bodies::set_pos(uint64_t index, const sf::Vector2<double>& pos) {
     assert(index <= n);
-    return pos_[index];
+    x_[index] = pos.x;
+    y_[index] = pos.y;
 }
 
-sf::Vector2<double>& Bodies::vel(uint64_t index) {
+sf::Vector2<double> Bodies::vel(uint64_t index) const {
     assert(index <= n);
-    return vel_[index];
+    return {vx_[index], vy_[index]};
 }
 
-const sf::Vector2<double>& Bodies::vel(uint64_t index) const {
+void Bodies::set_vel(uint64_t index, const sf::Vector2<double>& vel) {
     assert(index <= n);
-    return vel_[index];
+    vx_[index] = vel.x;
+    vy_[index] = vel.y;
+}
+
+std::span<double> Bodies::x() {
+    return {x_.data(), n};
+}
+
+std::span<const double> Bodies::x() const {
+    return {x_.data(), n};
+}
+
+std::span<double> Bodies::y() {
+    return {y_.data(), n};
+}
+
+std::span<const double> Bodies::y() const {
+    return {y_.data(), n};
+}
+
+std::span<double> Bodies::vx() {
+    return {vx_.data(), n};
+}
+
+std::span<const double> Bodies::vx() const {
+    return {vx_.data(), n};
+}
+
+std::span<double> Bodies::vy() {
+    return {vy_.data(), n};
+}
+
+std::span<const double> Bodies::vy() const {
+    return {vy_.data(), n};
+}
+
+std::span<double> Bodies::ax() {
+    return {ax_.data(), n};
+}
+
+std::span<const double> Bodies::ax() const {
+    return {ax_.data(), n};
+}
+
+std::span<double> Bodies::ay() {
+    return {ay_.data(), n};
+}
+
+std::span<const double> Bodies::ay() const {
+    return {ay_.data(), n};
+}
+
+std::span<double> Bodies::masses() {
+    return {mass_.data(), n};
+}
+
+std::span<const double> Bodies::masses() const {
+    return {mass_.data(), n};
 }
 
 double* Bodies::mass_data() {
@@ -79,22 +147,109 @@ const double* Bodies::mass_data() const {
     return mass_.data();
 }
 
-sf::Vector2<double>* Bodies::pos_data() {
-    return pos_.data();
+std::unique_lock<std::mutex> Bodies::lock_layout() const {
+    return std::unique_lock(*layout_mtx_);
+}
+
+uint64_t Bodies::original_index(uint64_t index) const {
+    assert(index < n);
+    return original_idxs_[index];
 }
 
-const sf::Vector2<double>* Bodies::pos_data() const {
-    return pos_.data();
+uint64_t Bodies::index_of(uint64_t original_index) const {
+    assert(original_index < input_n);
+    return idxs_[original_index];
 }
 
-sf::Vector2<double>* Bodies::vel_data() {
-    return vel_.data();
+// Each column is gathered into the spare buffer which is then swapped in
+void Bodies::reorder(std::span<const uint32_t> order) {
+    assert(order.size() == n);
+    const auto layout_lock = lock_layout();
+    const auto permute = [this, order](Column& column) {
+        reorder_buffer_.resize(padded_n, 0.0);
+        for (uint64_t i = 0; i < n; i++) {
+            reorder_buffer_[i] = column[order[i]];
+        }
+        column.swap(reorder_buffer_);
+    };
+    permute(mass_);
+    permute(x_);
+    permute(y_);
+    permute(vx_);
+    permute(vy_);
+    permute(ax_);
+    permute(ay_);
+
+    std::vector<std::string> ids(n);
+    std::vector<uint32_t> original_idxs(n);
+    for (uint64_t i = 0; i < n; i++) {
+        ids[i] = std::move(id_[order[i]]);
+        original_idxs[i] = original_idxs_[order[i]];
+        idxs_[original_idxs[i]] = i;
+    }
+    id_.swap(ids);
+    original_idxs_.swap(original_idxs);
 }
 
-const sf::Vector2<double>* Bodies::vel_data() const {
-    return vel_.data();
+// A survivor moves to the center of mass of its merged bodies. The accelerations are mass weighted,
+// which is the force the others exert on the merged body until the next force evaluation. The
+// columns keep their capacity and the freed tail is zeroed, so the padding stays zero, the spare
+// reorder buffer included.
+void Bodies::merge(std::span<const uint32_t> into) {
+    assert(into.size() == n);
+    const auto layout_lock = lock_layout();
+    for (uint64_t i = 0; i < n; i++) {
+        const uint32_t s = into[i];
+        if (s == i)
+            continue;
+        assert(into[s] == s);
+        const double mass = mass_[s] + mass_[i];
+        const double ws = mass_[s] / mass;
+        const double wi = mass_[i] / mass;
+        x_[s] = ws * x_[s] + wi * x_[i];
+        y_[s] = ws * y_[s] + wi * y_[i];
+        vx_[s] = ws * vx_[s] + wi * vx_[i];
+        vy_[s] = ws * vy_[s] + wi * vy_[i];
+        ax_[s] = ws * ax_[s] + wi * ax_[i];
+        ay_[s] = ws * ay_[s] + wi * ay_[i];
+        mass_[s] = mass;
+    }
+
+    std::vector<uint32_t> new_idxs(n);
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        if (into[i] != i)
+            continue;
+        new_idxs[i] = count;
+        if (count != i) {
+            mass_[count] = mass_[i];
+            x_[count] = x_[i];
+            y_[count] = y_[i];
+            vx_[count] = vx_[i];
+            vy_[count] = vy_[i];
+            ax_[count] = ax_[i];
+            ay_[count] = ay_[i];
+            id_[count] = std::move(id_[i]);
+            original_idxs_[count] = original_idxs_[i];
+        }
+        count++;
+    }
+    for (uint32_t& idx : idxs_) {
+        idx = new_idxs[into[idx]];
+    }
+    for (Column* column : {&mass_, &x_, &y_, &vx_, &vy_, &ax_, &ay_, &reorder_buffer_}) {
+        if (column->size() > count)
+            std::fill(column->begin() + count, column->end(), 0.0);
+    }
+    id_.resize(count);
+    original_idxs_.resize(count);
+    n = count;
+    padded_n = (n + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
 }
 
+bool Bodies::absorbed(uint64_t original_index) const {
+    return original_idxs_[index_of(original_index)] != original_index;
+}
 
 bool Bodies::validate_ids() const {
     std::unordered_set<std::string_view> unique_body_ids;
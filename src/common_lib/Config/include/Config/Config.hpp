@@ -23,13 +23,65 @@ public:
         double timestep;
         uint64_t iterations;
         std::string simtype_str;
-        enum class SimType : uint8_t { ALL_PAIRS, BARNES_HUT, BARNES_HUT_GPU } simtype;
+        enum class SimType : uint8_t {
+            ALL_PAIRS,
+            BARNES_HUT,
+            BARNES_HUT_GPU,
+            FMM,
+            PARTICLE_MESH,
+            TREE_PM
+        } simtype;
         double theta;
         double softening_factor;
         uint16_t threads;
+        std::string tree_builder_str;
+        enum class TreeBuilder : uint8_t { RECURSIVE, PARTITION, MORTON } tree_builder;
+        uint32_t leaf_size;
+        bool tree_refit;
+        bool quadrupole;
+        std::string walk_str;
+        enum class Walk : uint8_t { BODY, GROUP } walk;
+        std::string scheduler_str;
+        enum class Scheduler : uint8_t { STATIC, DYNAMIC, COST_ZONES } scheduler;
+        uint32_t reorder_interval;
+        uint32_t fmm_order;
+        uint32_t pm_grid;
+        std::string pm_assignment_str;
+        enum class PMAssignment : uint8_t { CIC, TSC } pm_assignment;
+        std::string pm_boundary_str;
+        enum class PMBoundary : uint8_t { PERIODIC, ISOLATED } pm_boundary;
+        double treepm_split;
+        std::string integrator_str;
+        enum class Integrator : uint8_t {
+            EULER,
+            LEAPFROG,
+            YOSHIDA4,
+            FOREST_RUTH,
+            WISDOM_HOLMAN
+        } integrator;
+        uint32_t block_levels;
+        double block_eta;
+        bool adaptive_timestep;
+        double timestep_eta;
+        uint32_t respa_interval;
+        double respa_split;
+        double binary_radius;
+        double merge_radius;
 
         bool parse_simtype();
+        bool parse_tree_builder();
+        bool parse_walk();
+        bool parse_scheduler();
+        bool parse_pm_assignment();
+        bool parse_pm_boundary();
+        bool parse_integrator();
         static std::string_view simtype_to_string(SimType simtype);
+        static std::string_view tree_builder_to_string(TreeBuilder tree_builder);
+        static std::string_view walk_to_string(Walk walk);
+        static std::string_view scheduler_to_string(Scheduler scheduler);
+        static std::string_view pm_assignment_to_string(PMAssignment pm_assignment);
+        static std::string_view pm_boundary_to_string(PMBoundary pm_boundary);
+        static std::string_view integrator_to_string(Integrator integrator);
         std::string to_string() const;
         bool validate();
     } sim;
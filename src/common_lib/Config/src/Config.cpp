@@ -32,7 +32,28 @@ Config::Config(const fs::path& path) {
                 .simtype_str = j_sim.at("algorithm"),
                 .theta = j_sim.at("theta"),
                 .softening_factor = j_sim.at("softening_factor"),
-                .threads = j_sim.at("threads")};
+                .threads = j_sim.at("threads"),
+                .tree_builder_str = j_sim.at("tree_builder"),
+                .leaf_size = j_sim.at("leaf_size"),
+                .tree_refit = j_sim.at("tree_refit"),
+                .quadrupole = j_sim.at("quadrupole"),
+                .walk_str = j_sim.at("walk"),
+                .scheduler_str = j_sim.at("scheduler"),
+                .reorder_interval = j_sim.at("reorder_interval"),
+                .fmm_order = j_sim.at("fmm_order"),
+                .pm_grid = j_sim.at("pm_grid"),
+                .pm_assignment_str = j_sim.at("pm_assignment"),
+                .pm_boundary_str = j_sim.at("pm_boundary"),
+                .treepm_split = j_sim.at("treepm_split"),
+                .integrator_str = j_sim.at("integrator"),
+                .block_levels = j_sim.at("block_levels"),
+                .block_eta = j_sim.at("block_eta"),
+                .adaptive_timestep = j_sim.at("adaptive_timestep"),
+                .timestep_eta = j_sim.at("timestep_eta"),
+                .respa_interval = j_sim.at("respa_interval"),
+                .respa_split = j_sim.at("respa_split"),
+                .binary_radius = j_sim.at("binary_radius"),
+                .merge_radius = j_sim.at("merge_radius")};
 
         const auto j_graphics = json_cfg.at("Graphics");
         graphics = Graphics{.enabled = j_graphics.at("enabled"),
@@ -171,19 +192,27 @@ std::string_view Config::Simulation::simtype_to_string(SimType simtype) {
         return "All Pairs";
     case SimType::BARNES_HUT_GPU:
         return "Barnes-Hut GPU";
+    case SimType::FMM:
+        return "FMM";
+    case SimType::PARTICLE_MESH:
+        return "Particle Mesh";
+    case SimType::TREE_PM:
+        return "TreePM";
     }
     assert(false);
     return {};
 }
 
+static std::string to_lower(std::string_view sv) {
+    std::string s;
+    s.reserve(sv.size());
+    for (char c : sv) {
+        s += std::tolower(c);
+    }
+    return s;
+}
+
 bool Config::Simulation::parse_simtype() {
-    const auto to_lower = [](std::string_view sv) {
-        std::string s(sv.size(), 0);
-        for (char c : sv) {
-            s += std::tolower(c);
-        }
-        return s;
-    };
     const auto simtype_str_lower = to_lower(simtype_str);
     Log::debug("`{}`", simtype_str_lower);
 
@@ -197,6 +226,15 @@ bool Config::Simulation::parse_simtype() {
     else if (simtype_str_lower == to_lower(simtype_to_string(SimType::BARNES_HUT_GPU))) {
         simtype = SimType::BARNES_HUT_GPU;
     }
+    else if (simtype_str_lower == to_lower(simtype_to_string(SimType::FMM))) {
+        simtype = SimType::FMM;
+    }
+    else if (simtype_str_lower == to_lower(simtype_to_string(SimType::PARTICLE_MESH))) {
+        simtype = SimType::PARTICLE_MESH;
+    }
+    else if (simtype_str_lower == to_lower(simtype_to_string(SimType::TREE_PM))) {
+        simtype = SimType::TREE_PM;
+    }
     else {
         ok = false;
     }
@@ -208,6 +246,223 @@ bool Config::Simulation::parse_simtype() {
     return ok;
 }
 
+std::string_view Config::Simulation::tree_builder_to_string(TreeBuilder tree_builder) {
+    switch (tree_builder) {
+    case TreeBuilder::RECURSIVE:
+        return "Recursive";
+    case TreeBuilder::PARTITION:
+        return "Partition";
+    case TreeBuilder::MORTON:
+        return "Morton";
+    }
+    assert(false);
+    return {};
+}
+
+bool Config::Simulation::parse_tree_builder() {
+    const auto tree_builder_str_lower = to_lower(tree_builder_str);
+
+    bool ok = true;
+    if (tree_builder_str_lower == to_lower(tree_builder_to_string(TreeBuilder::RECURSIVE))) {
+        tree_builder = TreeBuilder::RECURSIVE;
+    }
+    else if (tree_builder_str_lower == to_lower(tree_builder_to_string(TreeBuilder::PARTITION))) {
+        tree_builder = TreeBuilder::PARTITION;
+    }
+    else if (tree_builder_str_lower == to_lower(tree_builder_to_string(TreeBuilder::MORTON))) {
+        tree_builder = TreeBuilder::MORTON;
+    }
+    else {
+        ok = false;
+    }
+
+    if (ok) {
+        tree_builder_str = tree_builder_to_string(tree_builder);
+    }
+
+    return ok;
+}
+
+std::string_view Config::Simulation::walk_to_string(Walk walk) {
+    switch (walk) {
+    case Walk::BODY:
+        return "Body";
+    case Walk::GROUP:
+        return "Group";
+    }
+    assert(false);
+    return {};
+}
+
+bool Config::Simulation::parse_walk() {
+    const auto walk_str_lower = to_lower(walk_str);
+
+    bool ok = true;
+    if (walk_str_lower == to_lower(walk_to_string(Walk::BODY))) {
+        walk = Walk::BODY;
+    }
+    else if (walk_str_lower == to_lower(walk_to_string(Walk::GROUP))) {
+        walk = Walk::GROUP;
+    }
+    else {
+        ok = false;
+    }
+
+    if (ok) {
+        walk_str = walk_to_string(walk);
+    }
+
+    return ok;
+}
+
+std::string_view Config::Simulation::scheduler_to_string(Scheduler scheduler) {
+    switch (scheduler) {
+    case Scheduler::STATIC:
+        return "Static";
+    case Scheduler::DYNAMIC:
+        return "Dynamic";
+    case Scheduler::COST_ZONES:
+        return "Cost Zones";
+    }
+    assert(false);
+    return {};
+}
+
+bool Config::Simulation::parse_scheduler() {
+    const auto scheduler_str_lower = to_lower(scheduler_str);
+
+    bool ok = true;
+    if (scheduler_str_lower == to_lower(scheduler_to_string(Scheduler::STATIC))) {
+        scheduler = Scheduler::STATIC;
+    }
+    else if (scheduler_str_lower == to_lower(scheduler_to_string(Scheduler::DYNAMIC))) {
+        scheduler = Scheduler::DYNAMIC;
+    }
+    else if (scheduler_str_lower == to_lower(scheduler_to_string(Scheduler::COST_ZONES))) {
+        scheduler = Scheduler::COST_ZONES;
+    }
+    else {
+        ok = false;
+    }
+
+    if (ok) {
+        scheduler_str = scheduler_to_string(scheduler);
+    }
+
+    return ok;
+}
+
+std::string_view Config::Simulation::pm_assignment_to_string(PMAssignment pm_assignment) {
+    switch (pm_assignment) {
+    case PMAssignment::CIC:
+        return "CIC";
+    case PMAssignment::TSC:
+        return "TSC";
+    }
+    assert(false);
+    return {};
+}
+
+bool Config::Simulation::parse_pm_assignment() {
+    const auto pm_assignment_str_lower = to_lower(pm_assignment_str);
+
+    bool ok = true;
+    if (pm_assignment_str_lower == to_lower(pm_assignment_to_string(PMAssignment::CIC))) {
+        pm_assignment = PMAssignment::CIC;
+    }
+    else if (pm_assignment_str_lower == to_lower(pm_assignment_to_string(PMAssignment::TSC))) {
+        pm_assignment = PMAssignment::TSC;
+    }
+    else {
+        ok = false;
+    }
+
+    if (ok) {
+        pm_assignment_str = pm_assignment_to_string(pm_assignment);
+    }
+
+    return ok;
+}
+
+std::string_view Config::Simulation::pm_boundary_to_string(PMBoundary pm_boundary) {
+    switch (pm_boundary) {
+    case PMBoundary::PERIODIC:
+        return "Periodic";
+    case PMBoundary::ISOLATED:
+        return "Isolated";
+    }
+    assert(false);
+    return {};
+}
+
+bool Config::Simulation::parse_pm_boundary() {
+    const auto pm_boundary_str_lower = to_lower(pm_boundary_str);
+
+    bool ok = true;
+    if (pm_boundary_str_lower == to_lower(pm_boundary_to_string(PMBoundary::PERIODIC))) {
+        pm_boundary = PMBoundary::PERIODIC;
+    }
+    else if (pm_boundary_str_lower == to_lower(pm_boundary_to_string(PMBoundary::ISOLATED))) {
+        pm_boundary = PMBoundary::ISOLATED;
+    }
+    else {
+        ok = false;
+    }
+
+    if (ok) {
+        pm_boundary_str = pm_boundary_to_string(pm_boundary);
+    }
+
+    return ok;
+}
+
+std::string_view Config::Simulation::integrator_to_string(Integrator integrator) {
+    switch (integrator) {
+    case Integrator::EULER:
+        return "Euler";
+    case Integrator::LEAPFROG:
+        return "Leapfrog";
+    case Integrator::YOSHIDA4:
+        return "Yoshida4";
+    case Integrator::FOREST_RUTH:
+        return "Forest-Ruth";
+    case Integrator::WISDOM_HOLMAN:
+        return "Wisdom-Holman";
+    }
+    assert(false);
+    return {};
+}
+
+bool Config::Simulation::parse_integrator() {
+    const auto integrator_str_lower = to_lower(integrator_str);
+
+    bool ok = true;
+    if (integrator_str_lower == to_lower(integrator_to_string(Integrator::EULER))) {
+        integrator = Integrator::EULER;
+    }
+    else if (integrator_str_lower == to_lower(integrator_to_string(Integrator::LEAPFROG))) {
+        integrator = Integrator::LEAPFROG;
+    }
+    else if (integrator_str_lower == to_lower(integrator_to_string(Integrator::YOSHIDA4))) {
+        integrator = Integrator::YOSHIDA4;
+    }
+    else if (integrator_str_lower == to_lower(integrator_to_string(Integrator::FOREST_RUTH))) {
+        integrator = Integrator::FOREST_RUTH;
+    }
+    else if (integrator_str_lower == to_lower(integrator_to_string(Integrator::WISDOM_HOLMAN))) {
+        integrator = Integrator::WISDOM_HOLMAN;
+    }
+    else {
+        ok = false;
+    }
+
+    if (ok) {
+        integrator_str = integrator_to_string(integrator);
+    }
+
+    return ok;
+}
+
 std::string Config::Simulation::to_string() const {
     constexpr const char* fmt_str = R"(
   Simulation:
@@ -216,29 +471,66 @@ std::string Config::Simulation::to_string() const {
     algorithm:           `{}`
     theta:               {}
     softening_factor:    {}
-    threads:             {})";
+    threads:             {}
+    tree_builder:        `{}`
+    leaf_size:           {}
+    tree_refit:          {}
+    quadrupole:          {}
+    walk:                `{}`
+    scheduler:           `{}`
+    reorder_interval:    {}
+    fmm_order:           {}
+    pm_grid:             {}
+    pm_assignment:       `{}`
+    pm_boundary:         `{}`
+    treepm_split:        {}
+    integrator:          `{}`
+    block_levels:        {}
+    block_eta:           {}
+    adaptive_timestep:   {}
+    timestep_eta:        {}
+    respa_interval:      {}
+    respa_split:         {}
+    binary_radius:       {}
+    merge_radius:        {})";
     return fmt::format(fmt_str, timestep, iterations, simtype_str, theta, softening_factor,
-            threads);
+            threads, tree_builder_str, leaf_size, tree_refit, quadrupole, walk_str,
+            scheduler_str, reorder_interval, fmm_order, pm_grid, pm_assignment_str,
+            pm_boundary_str, treepm_split, integrator_str, block_levels, block_eta,
+            adaptive_timestep, timestep_eta, respa_interval, respa_split, binary_radius,
+            merge_radius);
 }
 
 bool Config::Simulation::validate() {
     using namespace Constants::Simulation;
     bool ok = true;
+    // The checks between options only run for the options that parsed
     if (!in_range(timestep, TIMESTEP_RANGE)) {
         ok = false;
         Log::error("Config::Simulation::timestep {} not within allowed range {}", timestep,
                 TIMESTEP_RANGE);
     }
-    if (!parse_simtype()) {
+    const bool simtype_ok = parse_simtype();
+    if (!simtype_ok) {
         ok = false;
-        Log::error("Config::Simulation::simtype `{}` is not one of the valid options `{}`, `{}`",
+        Log::error(
+                "Config::Simulation::simtype `{}` is not one of the valid options `{}`, `{}`, "
+                "`{}`, `{}`, `{}`, `{}`",
                 simtype_str, simtype_to_string(SimType::BARNES_HUT),
-                simtype_to_string(SimType::ALL_PAIRS));
+                simtype_to_string(SimType::ALL_PAIRS), simtype_to_string(SimType::BARNES_HUT_GPU),
+                simtype_to_string(SimType::FMM), simtype_to_string(SimType::PARTICLE_MESH),
+                simtype_to_string(SimType::TREE_PM));
     }
     if (!in_range(theta, THETA_RANGE)) {
         ok = false;
         Log::error("Config::Simulation::theta {} not within allowed range {}", theta, THETA_RANGE);
     }
+    else if (simtype_ok && simtype == SimType::FMM && theta >= 1.0) {
+        // Expansions only converge for nodes further apart than the sum of their radii
+        ok = false;
+        Log::error("Config::Simulation::theta {} must be below 1 for the `{}` algorithm", theta,
+                simtype_to_string(SimType::FMM));
+    }
     if (!in_range(softening_factor, SOFTENING_FACTOR_RANGE)) {
         ok = false;
         Log::error("Config::Simuation::softening_factor {} not withing allowed range {}",
@@ -249,6 +541,252 @@ bool Config::Simulation::validate() {
         Log::error("Config::Simulation::threads {} not within allowed range {}", threads,
                 THREADS_RANGE);
     }
+    const bool tree_builder_ok = parse_tree_builder();
+    if (!tree_builder_ok) {
+        ok = false;
+        Log::error(
+                "Config::Simulation::tree_builder `{}` is not one of the valid options `{}`, `{}`, "
+                "`{}`",
+                tree_builder_str, tree_builder_to_string(TreeBuilder::RECURSIVE),
+                tree_builder_to_string(TreeBuilder::PARTITION),
+                tree_builder_to_string(TreeBuilder::MORTON));
+    }
+    if (!in_range(leaf_size, LEAF_SIZE_RANGE)) {
+        ok = false;
+        Log::error("Config::Simulation::leaf_size {} not within allowed range {}", leaf_size,
+                LEAF_SIZE_RANGE);
+    }
+    if (tree_builder_ok && tree_refit && tree_builder != TreeBuilder::PARTITION) {
+        ok = false;
+        Log::error("Config::Simulation::tree_refit requires the `{}` tree_builder, not `{}`",
+                tree_builder_to_string(TreeBuilder::PARTITION), tree_builder_str);
+    }
+    if (!parse_walk()) {
+        ok = false;
+        Log::error("Config::Simulation::walk `{}` is not one of the valid options `{}`, `{}`",
+                walk_str, walk_to_string(Walk::BODY), walk_to_string(Walk::GROUP));
+    }
+    if (!parse_scheduler()) {
+        ok = false;
+        Log::error(
+                "Config::Simulation::scheduler `{}` is not one of the valid options `{}`, `{}`, "
+                "`{}`",
+                scheduler_str, scheduler_to_string(Scheduler::STATIC),
+                scheduler_to_string(Scheduler::DYNAMIC),
+                scheduler_to_string(Scheduler::COST_ZONES));
+    }
+    if (!in_range(reorder_interval, REORDER_INTERVAL_RANGE)) {
+        ok = false;
+        Log::error("Config::Simulation::reorder_interval {} not within allowed range {}",
+                reorder_interval, REORDER_INTERVAL_RANGE);
+    }
+    if (!in_range(fmm_order, FMM_ORDER_RANGE)) {
+        ok = false;
+        Log::error("Config::Simulation::fmm_order {} not within allowed range {}", fmm_order,
+                FMM_ORDER_RANGE);
+    }
+    if (!in_range(pm_grid, PM_GRID_RANGE) || (pm_grid & (pm_grid - 1)) != 0) {
+        ok = false;
+        Log::error("Config::Simulation::pm_grid {} is not a power of two within allowed range {}",
+                pm_grid, PM_GRID_RANGE);
+    }
+    if (!parse_pm_assignment()) {
+        ok = false;
+        Log::error("Config::Simulation::pm_assignment `{}` is not one of the valid options `{}`, "
+                   "`{}`",
+                pm_assignment_str, pm_assignment_to_string(PMAssignment::CIC),
+                pm_assignment_to_string(PMAssignment::TSC));
+    }
+    const bool pm_boundary_ok = parse_pm_boundary();
+    if (!pm_boundary_ok) {
+        ok = false;
+        Log::error("Config::Simulation::pm_boundary `{}` is not one of the valid options `{}`, "
+                   "`{}`",
+                pm_boundary_str, pm_boundary_to_string(PMBoundary::PERIODIC),
+                pm_boundary_to_string(PMBoundary::ISOLATED));
+    }
+    else if (pm_boundary == PMBoundary::ISOLATED && in_range(pm_grid, PM_GRID_RANGE)
+            && 2 * pm_grid > PM_MAX_FFT_GRID) {
+        // The isolated mesh is zero padded to twice its side for the FFT
+        ok = false;
+        Log::error("Config::Simulation::pm_grid {} is over {} with the `{}` pm_boundary", pm_grid,
+                PM_MAX_FFT_GRID / 2, pm_boundary_to_string(PMBoundary::ISOLATED));
+    }
+    if (!in_range(treepm_split, TREEPM_SPLIT_RANGE)) {
+        ok = false;
+        Log::error("Config::Simulation::treepm_split {} not within allowed range {}", treepm_split,
+                TREEPM_SPLIT_RANGE);
+    }
+    else if (simtype_ok && simtype == SimType::TREE_PM && pm_boundary_ok
+            && pm_boundary == PMBoundary::PERIODIC && in_range(pm_grid, PM_GRID_RANGE)
+            && TREEPM_CUTOFF_SPLITS * treepm_split > pm_grid / 4.0) {
+        // The short range cutoff must stay under a quarter of the box, nearest images are only
+        // unambiguous for nodes well within half of it
+        ok = false;
+        Log::error("Config::Simulation::treepm_split {} is over {:.3g} with pm_grid {} and the "
+                   "`{}` pm_boundary",
+                treepm_split, pm_grid / 4.0 / TREEPM_CUTOFF_SPLITS, pm_grid,
+                pm_boundary_to_string(PMBoundary::PERIODIC));
+    }
+    const bool integrator_ok = parse_integrator();
+    if (!integrator_ok) {
+        ok = false;
+        Log::error(
+                "Config::Simulation::integrator `{}` is not one of the valid options `{}`, `{}`, "
+                "`{}`, `{}`, `{}`",
+                integrator_str, integrator_to_string(Integrator::EULER),
+                integrator_to_string(Integrator::LEAPFROG),
+                integrator_to_string(Integrator::YOSHIDA4),
+                integrator_to_string(Integrator::FOREST_RUTH),
+                integrator_to_string(Integrator::WISDOM_HOLMAN));
+    }
+    else if (simtype_ok && simtype == SimType::BARNES_HUT_GPU && integrator != Integrator::EULER) {
+        // The device kernels kick and drift the bodies themselves
+        ok = false;
+        Log::error("Config::Simulation::integrator `{}` is not supported by the `{}` algorithm",
+                integrator_str, simtype_to_string(SimType::BARNES_HUT_GPU));
+    }
+    else if (integrator == Integrator::WISDOM_HOLMAN) {
+        // The orbits around the central body are drifted in open space
+        if (simtype_ok && (simtype == SimType::PARTICLE_MESH || simtype == SimType::TREE_PM)
+                && pm_boundary_ok && pm_boundary == PMBoundary::PERIODIC) {
+            ok = false;
+            Log::error("Config::Simulation::integrator `{}` requires the `{}` pm_boundary",
+                    integrator_str, pm_boundary_to_string(PMBoundary::ISOLATED));
+        }
+        // The accelerations are dominated by the central body, not by the perturbations that
+        // limit the timestep
+        if (adaptive_timestep) {
+            ok = false;
+            Log::error("Config::Simulation::adaptive_timestep is not supported by the `{}` "
+                       "integrator",
+                    integrator_str);
+        }
+    }
+    if (!in_range(block_levels, BLOCK_LEVELS_RANGE)) {
+        ok = false;
+        Log::error("Config::Simulation::block_levels {} not within allowed range {}", block_levels,
+                BLOCK_LEVELS_RANGE);
+    }
+    else if (block_levels != 0) {
+        // Only the engines with a per-body force evaluation can update a subset of the bodies
+        if (simtype_ok && simtype != SimType::BARNES_HUT && simtype != SimType::ALL_PAIRS) {
+            ok = false;
+            Log::error("Config::Simulation::block_levels requires the `{}` or `{}` algorithm, not "
+                       "`{}`",
+                    simtype_to_string(SimType::BARNES_HUT), simtype_to_string(SimType::ALL_PAIRS),
+                    simtype_str);
+        }
+        if (integrator_ok && integrator != Integrator::LEAPFROG) {
+            ok = false;
+            Log::error("Config::Simulation::block_levels requires the `{}` integrator, not `{}`",
+                    integrator_to_string(Integrator::LEAPFROG), integrator_str);
+        }
+        if (softening_factor == 0.0) {
+            // The timestep criterion scales with the softening length
+            ok = false;
+            Log::error("Config::Simulation::block_levels requires a non-zero softening_factor");
+        }
+    }
+    if (!in_range(block_eta, BLOCK_ETA_RANGE)) {
+        ok = false;
+        Log::error("Config::Simulation::block_eta {} not within allowed range {}", block_eta,
+                BLOCK_ETA_RANGE);
+    }
+    if (adaptive_timestep) {
+        // The controller reads the accelerations the CPU engines leave in the bodies
+        if (simtype_ok && simtype == SimType::BARNES_HUT_GPU) {
+            ok = false;
+            Log::error("Config::Simulation::adaptive_timestep is not supported by the `{}` "
+                       "algorithm",
+                    simtype_to_string(SimType::BARNES_HUT_GPU));
+        }
+        if (block_levels != 0) {
+            ok = false;
+            Log::error("Config::Simulation::adaptive_timestep and block_levels are exclusive");
+        }
+        if (softening_factor == 0.0) {
+            ok = false;
+            Log::error("Config::Simulation::adaptive_timestep requires a non-zero "
+                       "softening_factor");
+        }
+    }
+    if (!in_range(timestep_eta, TIMESTEP_ETA_RANGE)) {
+        ok = false;
+        Log::error("Config::Simulation::timestep_eta {} not within allowed range {}",
+                timestep_eta, TIMESTEP_ETA_RANGE);
+    }
+    if (!in_range(respa_interval, RESPA_INTERVAL_RANGE)) {
+        ok = false;
+        Log::error("Config::Simulation::respa_interval {} not within allowed range {}",
+                respa_interval, RESPA_INTERVAL_RANGE);
+    }
+    else if (respa_interval > 1) {
+        // The split is the tree walk's, and it nests leapfrog steps of fixed length
+        if (simtype_ok && simtype != SimType::BARNES_HUT) {
+            ok = false;
+            Log::error("Config::Simulation::respa_interval requires the `{}` algorithm, not `{}`",
+                    simtype_to_string(SimType::BARNES_HUT), simtype_str);
+        }
+        if (integrator_ok && integrator != Integrator::LEAPFROG) {
+            ok = false;
+            Log::error("Config::Simulation::respa_interval requires the `{}` integrator, not `{}`",
+                    integrator_to_string(Integrator::LEAPFROG), integrator_str);
+        }
+        if (block_levels != 0 || adaptive_timestep) {
+            ok = false;
+            Log::error("Config::Simulation::respa_interval, block_levels and adaptive_timestep are "
+                       "exclusive");
+        }
+    }
+    if (!in_range(respa_split, RESPA_SPLIT_RANGE)) {
+        ok = false;
+        Log::error("Config::Simulation::respa_split {} not within allowed range {}", respa_split,
+                RESPA_SPLIT_RANGE);
+    }
+    if (!in_range(binary_radius, BINARY_RADIUS_RANGE)) {
+        ok = false;
+        Log::error("Config::Simulation::binary_radius {} not within allowed range {}",
+                binary_radius, BINARY_RADIUS_RANGE);
+    }
+    else if (binary_radius != 0.0) {
+        // The pairs are found with the force tree and kicked around a leapfrog drift
+        if (simtype_ok && simtype != SimType::BARNES_HUT) {
+            ok = false;
+            Log::error("Config::Simulation::binary_radius requires the `{}` algorithm, not `{}`",
+                    simtype_to_string(SimType::BARNES_HUT), simtype_str);
+        }
+        if (integrator_ok && integrator != Integrator::LEAPFROG) {
+            ok = false;
+            Log::error("Config::Simulation::binary_radius requires the `{}` integrator, not `{}`",
+                    integrator_to_string(Integrator::LEAPFROG), integrator_str);
+        }
+        // The accelerations the other modes read still hold the pairs' own forces
+        if (block_levels != 0 || respa_interval > 1 || adaptive_timestep) {
+            ok = false;
+            Log::error("Config::Simulation::binary_radius, block_levels, respa_interval and "
+                       "adaptive_timestep are exclusive");
+        }
+    }
+    if (!in_range(merge_radius, MERGE_RADIUS_RANGE)) {
+        ok = false;
+        Log::error("Config::Simulation::merge_radius {} not within allowed range {}", merge_radius,
+                MERGE_RADIUS_RANGE);
+    }
+    else if (merge_radius != 0.0) {
+        // The encounters are found with the force tree, which only Barnes-Hut keeps
+        if (simtype_ok && simtype != SimType::BARNES_HUT) {
+            ok = false;
+            Log::error("Config::Simulation::merge_radius requires the `{}` algorithm, not `{}`",
+                    simtype_to_string(SimType::BARNES_HUT), simtype_str);
+        }
+        // Their per-body state is not compacted
+        if (block_levels != 0 || respa_interval > 1 || binary_radius != 0.0) {
+            ok = false;
+            Log::error("Config::Simulation::merge_radius, block_levels, respa_interval and "
+                       "binary_radius are exclusive");
+        }
+    }
     return ok;
 }
 
@@ -21,11 +21,53 @@ const char* const ALLOWED_ALGORITHMS[] = {"barnes-hut", "naive"};
 constexpr Range<double> SOFTENING_FACTOR_RANGE = {0.0, 0.2};
 constexpr Range<uint16_t> THREADS_RANGE = {1, 256};
 constexpr Range<double> THETA_RANGE = {0.0, 100.0};
+constexpr Range<uint32_t> LEAF_SIZE_RANGE = {1, 256};
+// Steps between spatial reorderings of the bodies, 0 disables it
+constexpr Range<uint32_t> REORDER_INTERVAL_RANGE = {0, 1'000'000};
+// Group walk: largest cell whose bodies share one interaction list
+constexpr uint32_t GROUP_WALK_MAX_BODIES = 32;
+// Scheduler::DYNAMIC: bodies claimed per atomic increment (group walks: in whole groups)
+constexpr uint32_t DYNAMIC_CHUNK_BODIES = 128;
+// FMM: highest order of the multipole and local expansions
+constexpr Range<uint32_t> FMM_ORDER_RANGE = {1, 16};
+// FMM: the tree is cut into about this many subtrees per thread, the units of parallel work
+constexpr uint32_t FMM_SUBTREES_PER_THREAD = 16;
+// Particle mesh: cells per side of the mesh, a power of two
+constexpr Range<uint32_t> PM_GRID_RANGE = {16, 4096};
+// Particle mesh: largest side of the FFT grid, which the isolated boundary pads to twice the mesh
+constexpr uint32_t PM_MAX_FFT_GRID = 4096;
+// Particle mesh: the mesh side over the extent of the bodies when it is fitted to them
+constexpr double PM_BOX_SLACK = 1.25;
+// Particle mesh, isolated: cells kept free at the edges, the reach of a stencil and its gradient
+constexpr uint32_t PM_ISOLATED_MARGIN_CELLS = 4;
+// TreePM: split scale r_s between the mesh and the tree, in mesh cells
+constexpr Range<double> TREEPM_SPLIT_RANGE = {0.5, 8.0};
+// TreePM: the short range walk ignores everything beyond this many r_s
+constexpr double TREEPM_CUTOFF_SPLITS = 4.5;
+// Block timesteps: levels below the base timestep, level k steps timestep / 2^k. 0 disables them.
+constexpr Range<uint32_t> BLOCK_LEVELS_RANGE = {0, 16};
+// Block timesteps: accuracy parameter of the criterion dt = sqrt(2 eta epsilon / |a|)
+constexpr Range<double> BLOCK_ETA_RANGE = {1e-4, 1.0};
+// Adaptive timestep: accuracy parameter of the criterion dt = sqrt(2 eta epsilon / max |a|)
+constexpr Range<double> TIMESTEP_ETA_RANGE = {1e-4, 1.0};
+// Adaptive timestep: largest growth of the timestep from one iteration to the next
+constexpr double ADAPTIVE_TIMESTEP_MAX_GROWTH = 1.25;
+// RESPA: iterations between far field evaluations, 1 disables the near/far split
+constexpr Range<uint32_t> RESPA_INTERVAL_RANGE = {1, 64};
+// RESPA: split scale r_s (m) of the smooth near/far force split, the same kernel as TreePM
+constexpr Range<double> RESPA_SPLIT_RANGE = {1.0, 1e30};
+// RESPA: the near share of an interaction reaches zero at this many r_s
+constexpr double RESPA_CUTOFF_SPLITS = 4.5;
+// Binaries: largest separation (m) of a bound pair that is regularized, 0 disables them
+constexpr Range<double> BINARY_RADIUS_RANGE = {0.0, 1e30};
+// Mergers: separation (m) below which two bodies merge into one, 0 disables merging
+constexpr Range<double> MERGE_RADIUS_RANGE = {0.0, 1e30};
 constexpr auto STATS_UPDATE_TIMER = std::chrono::microseconds(50);
 constexpr uint64_t MAX_PAIRWISE_SOFTENING_COMPUTATIONS = 1'000'000;
 constexpr double TIMESTEP_CHANGE_FACTOR = 1.1;
 
 static_assert(TIMESTEP_CHANGE_FACTOR > 1.0);
+static_assert(ADAPTIVE_TIMESTEP_MAX_GROWTH > 1.0);
 }  // namespace Simulation
 
 namespace Graphics {
@@ -44,8 +86,8 @@ constexpr sf::Color GRID_COLOR(255, 255, 255, 64);
 constexpr sf::Color SELECT_COLOR(255, 0, 0, 200);
 constexpr uint8_t FPS_CALC_BUFFER_LEN = 60;
 constexpr Range<float> PANEL_UPDATE_HZ_RANGE = {0.1, 30};
-constexpr sf::Vector2u CONFIG_PANEL_RES = {340, 240};
-constexpr sf::Vector2u STATS_PANEL_RES = {340, 200};
+constexpr sf::Vector2u CONFIG_PANEL_RES = {340, 260};
+constexpr sf::Vector2u STATS_PANEL_RES = {340, 220};
 constexpr sf::Vector2u COMMANDS_PANEL_RES = {370, 220};
 constexpr auto STATS_UPDATE_TIMER = std::chrono::microseconds(50);
 
@@ -59,7 +59,12 @@ void IO::write_csv(const fs::path& path, const Bodies& bodies) {
             throw std::runtime_error("Failed to open file");
         }
         out_file << "id,mass,x,y,vel_x,vel_y\n";
-        for (uint64_t i = 0; i < bodies.n; i++) {
+        // The simulation may have reordered the bodies, they are written in the input order. A
+        // merged body is written once, with the id of the survivor.
+        for (uint64_t original_idx = 0; original_idx < bodies.input_n; original_idx++) {
+            if (bodies.absorbed(original_idx))
+                continue;
+            const uint64_t i = bodies.index_of(original_idx);
             out_file << fmt::format("{},{},{},{},{},{}\n", bodies.id(i), bodies.mass(i),
                     bodies.pos(i).x, bodies.pos(i).y, bodies.vel(i).x, bodies.vel(i).y);
         }
@@ -69,4 +74,7 @@ void IO::write_csv(const fs::path& path, const Bodies& bodies) {
         throw std::runtime_error("Failed to write: `" + path.string() + "`");
     }
     Log::debug("Wrote {} bodies to `{}`: [{}]", bodies.n, path.c_str(), sw);
+    if (bodies.n != bodies.input_n)
+        Log::info("{} of the {} input bodies merged into others", bodies.input_n - bodies.n,
+                bodies.input_n);
 }
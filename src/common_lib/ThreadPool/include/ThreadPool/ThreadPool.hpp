@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Fixed set of long-lived threads. Between tasks the threads are parked on a condition variable,
+// so launching a task costs a wake-up instead of a thread creation.
+class ThreadPool {
+public:
+    using Task = std::function<void(uint16_t thread_idx)>;
+
+    ThreadPool(uint16_t n_threads);
+    ~ThreadPool();
+    uint16_t size() const;
+    // Runs `task(thread_idx)` on the first `n_threads` pool threads and returns immediately.
+    // Waits for the previous task first.
+    void launch(Task task, uint16_t n_threads);
+    void launch(Task task);
+    // Blocks until every thread has returned from the launched task
+    void wait();
+    // launch() followed by wait()
+    void run(Task task, uint16_t n_threads);
+    void run(Task task);
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mtx;
+    std::condition_variable task_cv;
+    std::condition_variable done_cv;
+    Task task;
+    uint64_t generation = 0;
+    uint16_t participants = 0;
+    uint16_t running = 0;
+    bool shutdown = false;
+
+    void thread_loop(uint16_t thread_idx);
+};
@@ -0,0 +1,80 @@
+#include "ThreadPool/ThreadPool.hpp"
+
+#include <cassert>
+
+
+ThreadPool::ThreadPool(uint16_t n_threads) {
+    threads.reserve(n_threads);
+    for (uint16_t i = 0; i < n_threads; i++) {
+        threads.emplace_back(&ThreadPool::thread_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard lock(mtx);
+        shutdown = true;
+    }
+    task_cv.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+uint16_t ThreadPool::size() const {
+    return threads.size();
+}
+
+void ThreadPool::launch(Task task, uint16_t n_threads) {
+    assert(n_threads <= size());
+    {
+        std::unique_lock lock(mtx);
+        done_cv.wait(lock, [this] { return running == 0; });
+        this->task = std::move(task);
+        participants = n_threads;
+        running = n_threads;
+        generation++;
+    }
+    task_cv.notify_all();
+}
+
+void ThreadPool::launch(Task task) {
+    launch(std::move(task), size());
+}
+
+void ThreadPool::wait() {
+    std::unique_lock lock(mtx);
+    done_cv.wait(lock, [this] { return running == 0; });
+}
+
+void ThreadPool::run(Task task, uint16_t n_threads) {
+    launch(std::move(task), n_threads);
+    wait();
+}
+
+void ThreadPool::run(Task task) {
+    run(std::move(task), size());
+}
+
+// `task` is only replaced once `running` drops to 0, so it can be called without the lock
+void ThreadPool::thread_loop(uint16_t thread_idx) {
+    uint64_t seen_generation = 0;
+    std::unique_lock lock(mtx);
+    while (true) {
+        task_cv.wait(lock, [this, seen_generation] {
+            return shutdown || generation != seen_generation;
+        });
+        if (shutdown)
+            return;
+        seen_generation = generation;
+        if (thread_idx >= participants)
+            continue;
+
+        lock.unlock();
+        task(thread_idx);
+        lock.lock();
+        if (--running == 0)
+            done_cv.notify_all();
+    }
+}
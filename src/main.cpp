@@ -13,7 +13,10 @@
 #include "Simulation/AllPairs.hpp"
 #include "Simulation/BarnesHut.hpp"
 #include "Simulation/BarnesHutCuda.hpp"
+#include "Simulation/FMM.hpp"
+#include "Simulation/ParticleMesh.hpp"
 #include "Simulation/Simulation.hpp"
+#include "Simulation/TreePM.hpp"
 
 // Signal handler can only use signal-safe code
 void sigint_handler(int signum) {
@@ -33,6 +36,15 @@ std::unique_ptr<Simulation> create_sim(const Config::Simulation& sim_cfg, Bodies
     else if (sim_cfg.simtype == Config::Simulation::SimType::BARNES_HUT_GPU) {
         return std::make_unique<BarnesHutCuda>(sim_cfg, bodies);
     }
+    else if (sim_cfg.simtype == Config::Simulation::SimType::FMM) {
+        return std::make_unique<FMM>(sim_cfg, bodies);
+    }
+    else if (sim_cfg.simtype == Config::Simulation::SimType::PARTICLE_MESH) {
+        return std::make_unique<ParticleMesh>(sim_cfg, bodies);
+    }
+    else if (sim_cfg.simtype == Config::Simulation::SimType::TREE_PM) {
+        return std::make_unique<TreePM>(sim_cfg, bodies);
+    }
     assert(false);
     return nullptr;
 }